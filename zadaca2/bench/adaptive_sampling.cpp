@@ -0,0 +1,117 @@
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+
+#include <fstream>
+#include <vector>
+
+#include <lights/shadow_culled_lights.h>
+
+#include <rendering/camera.h>
+#include <rendering/progressive.h>
+
+#include <scenes/scene_file.h>
+
+#include <threading/thread_pool.h>
+
+/*
+** Error of the main scene against a converged reference after the same
+** time spent rendering, taking every sample of every pixel and taking
+** samples adaptively.
+**
+** The reference is 256 uniform samples per pixel. Error is the root
+** mean square difference of the colour channels in 8 bit levels.
+*/
+
+constexpr auto width     = 320;
+constexpr auto height    = 180;
+constexpr auto reference = 256;
+
+double rms_error(
+    std::vector<float3> const& image,
+    std::vector<float3> const& truth)
+{
+    double sum = 0;
+
+    for (std::size_t i = 0; i < image.size(); ++i)
+    {
+        float3 const d = image[i] - truth[i];
+        sum += d.x * d.x + d.y * d.y + d.z * d.z;
+    }
+
+    return std::sqrt(sum / (3 * image.size()));
+}
+
+int main()
+{
+    std::ifstream scene_input("../scenes/kugle.scene");
+
+    if (not scene_input)
+    {
+        std::cerr << "run from the build directory, next to ../scenes\n";
+        return 1;
+    }
+
+    auto const scene  = parse_scene(scene_input);
+    auto const lights = build_shadow_culled_lights(scene.lights, scene.objects);
+
+    Camera const camera = default_camera(width, height);
+
+    Sampler const sampler
+    {
+        .samples_per_pixel = reference,
+        .width             = width,
+        .height            = height,
+    };
+
+    ThreadPool pool;
+
+    auto render = [&](ProgressiveSettings const settings, double* samples = nullptr)
+    {
+        auto image = make_progressive_image(sampler);
+        auto taken = render_progressive(pool, camera, image, scene.objects, scene.materials, lights, settings);
+
+        if (samples)
+            *samples = static_cast<double>(taken) / (width * height);
+
+        return resolve_progressive_image(image);
+    };
+
+    auto const start = std::chrono::steady_clock::now();
+    auto const truth = render({});
+
+    std::cout << width << 'x' << height << ", reference of " << reference << " samples per pixel in "
+              << std::fixed << std::setprecision(1)
+              << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s\n\n"
+              << std::setw(10) << "budget ms"
+              << std::setw(16) << "uniform spp"
+              << std::setw(16) << "uniform error"
+              << std::setw(16) << "adaptive spp"
+              << std::setw(16) << "adaptive error"
+              << '\n';
+
+    for (int const budget : {250, 500, 1000, 2000, 4000})
+    {
+        double uniform_samples, adaptive_samples;
+
+        auto const uniform  = render({
+            .time_budget = std::chrono::milliseconds(budget),
+        }, &uniform_samples);
+
+        auto const adaptive = render({
+            .error_threshold = 0.5f,
+            .min_samples     = 8,
+            .time_budget     = std::chrono::milliseconds(budget),
+        }, &adaptive_samples);
+
+        std::cout << std::setprecision(2)
+                  << std::setw(10) << budget
+                  << std::setw(16) << uniform_samples
+                  << std::setw(16) << rms_error(uniform, truth)
+                  << std::setw(16) << adaptive_samples
+                  << std::setw(16) << rms_error(adaptive, truth)
+                  << std::endl;
+    }
+}
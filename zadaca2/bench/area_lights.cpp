@@ -0,0 +1,145 @@
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+
+#include <vector>
+
+#include <linear_algebra.h>
+
+#include <objects/object.h>
+#include <objects/sphere.h>
+#include <objects/cylinder.h>
+#include <objects/cuboid.h>
+
+#include <lights/point_light.h>
+#include <lights/area_lights.h>
+
+#include <rays/ray.h>
+#include <rays/tracing.h>
+
+#include <rendering/camera.h>
+
+/*
+** Soft shadows from the main scene's lights grown into area lights,
+** with a fixed number of shadow rays per light against the adaptive
+** scheme, and the original point lights for the cost of hard shadows.
+** Errors are RMS against a render with 256 rays everywhere.
+*/
+
+// Every 4th pixel of the full frame, to keep the reference affordable.
+constexpr auto width  = 1920;
+constexpr auto height = 1080;
+constexpr auto stride = 4;
+
+template <typename Lights>
+std::vector<float3> render_sparse(
+    std::vector<Object const*> const& objects,
+    MaterialTable              const& materials,
+    Lights                     const& lights)
+{
+    Camera const camera = default_camera(width, height);
+    auto const rays = make_camera_rays(camera, width, height);
+
+    std::vector<float3> image;
+
+    for (int j = 0; j < height; j += stride)
+    {
+        for (int i = 0; i < width; i += stride)
+        {
+            image.push_back(
+                trace<16>(primary_ray(rays, i, j), objects, materials, lights)
+            );
+        }
+    }
+
+    return image;
+}
+
+template <typename F>
+double milliseconds(F&& f)
+{
+    auto const start = std::chrono::steady_clock::now();
+    f();
+    auto const end   = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+double rms_error(
+    std::vector<float3> const& image,
+    std::vector<float3> const& reference)
+{
+    double sum = 0;
+
+    for (std::size_t i = 0; i < image.size(); ++i)
+    {
+        float3 const d = image[i] - reference[i];
+        sum += d.dot(d) / 3;
+    }
+
+    return std::sqrt(sum / image.size());
+}
+
+int main()
+{
+    MaterialTable const materials = {
+        { {255,  24,  24}, 0.6, 0.3, 60, 0.4 },
+        { { 24, 100,  24}, 0.6, 0.3, 60, 0.4 },
+        { { 24,  24, 100}, 0.6, 0.3, 60, 0.4 },
+        { {255, 255, 255}, 0.6, 0.3, 60, 0.4 },
+    };
+
+    Cuboid   const floor(3, {-1000, -200, 0}, {1000, -150, -800});
+    Sphere   const s1   (1, {0, -90, -350}, 60);
+    Cylinder const v1   (0, {150, -150, -400}, 25, 65);
+    Cuboid   const c1   (2, {-200, -149, -300}, {-125, -76, -375});
+
+    std::vector<Object const*> const objects = {&floor, &s1, &v1, &c1};
+
+    std::vector<PointLight> const point_lights = {
+        { {-20, -149, -50}, 1.4 },
+        { {-35,  120, 0}  , 2   },
+        { {150,  180, 20} , 1   },
+    };
+
+    std::vector<AreaLight> const area_lights = {
+        make_sphere_light   ({-20, -149, -50}, 0.8f, 1.4f),
+        make_rectangle_light({-35,  120, 0}, {80, 0, 0}, {0, 0, 80}, 2),
+        make_sphere_light   ({150,  180, 20}, 20, 1),
+    };
+
+    auto const fixed = [&](int const samples)
+    {
+        return build_area_lights(area_lights, objects, {samples, samples});
+    };
+
+    std::vector<float3> reference;
+    milliseconds([&] { reference = render_sparse(objects, materials, fixed(256)); });
+
+    std::cout << width / stride << 'x' << height / stride << " pixels, "
+              << "error is RMS against 256 shadow rays per light\n\n"
+              << std::setw(20) << "lights"
+              << std::setw(12) << "ms"
+              << std::setw(10) << "error"
+              << '\n';
+
+    auto const report = [&](char const* name, auto const& lights)
+    {
+        std::vector<float3> image;
+        auto const time = milliseconds([&] { image = render_sparse(objects, materials, lights); });
+
+        std::cout << std::fixed << std::setprecision(1)
+                  << std::setw(20) << name
+                  << std::setw(12) << time
+                  << std::setw(10) << rms_error(image, reference)
+                  << std::endl;
+    };
+
+    report("point"         , point_lights);
+    report("area, 4 rays"  , fixed(4));
+    report("area, 16 rays" , fixed(16));
+    report("area, 64 rays" , fixed(64));
+    report("area, adaptive", build_area_lights(area_lights, objects));
+}
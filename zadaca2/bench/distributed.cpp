@@ -0,0 +1,115 @@
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <rendering/camera.h>
+#include <rendering/render_cache.h>
+
+#include <service/distributed.h>
+#include <service/render_protocol.h>
+#include <service/unix_socket.h>
+
+/*
+** Speedup of a frame split across worker processes over the same frame
+** on a single worker, for growing worker counts, and the cost of losing
+** a worker part way through. Workers are forked from this process and
+** talk to the coordinator over a Unix socket, as separate machines
+** would over a forwarded one.
+**
+** Speedup is bounded by the cores of the machine running it.
+*/
+
+constexpr auto width  = 1920;
+constexpr auto height = 1080;
+
+DistributedStats run(
+    RenderRequest const& job,
+    int           const  workers,
+    int           const  failing = 0)
+{
+    std::string const path = "/tmp/zadaca2-bench-distributed.sock";
+
+    auto const listener = listen_unix(path);
+
+    std::vector<pid_t> children;
+
+    for (int k = 0; k < workers; ++k)
+    {
+        pid_t const pid = ::fork();
+
+        if (pid == 0)
+        {
+            run_render_worker(path, k < failing ? 20 : 0);
+            ::_exit(0);
+        }
+
+        children.push_back(pid);
+    }
+
+    DistributedStats stats;
+    (void) render_distributed(listener, job, {}, &stats);
+
+    for (pid_t const child : children)
+        ::waitpid(child, nullptr, 0);
+
+    ::unlink(path.c_str());
+
+    return stats;
+}
+
+int main()
+{
+    RenderRequest const job
+    {
+        .scene_id = "kugle",
+        .width    = width,
+        .height   = height,
+        .priority = 0,
+        .camera   = default_camera(width, height),
+        .scene    = read_file("../scenes/kugle.scene"),
+    };
+
+    if (job.scene->empty())
+    {
+        std::cerr << "run from the build directory, next to ../scenes\n";
+        return 1;
+    }
+
+    std::cout << width << 'x' << height << ", 64x64 tiles, "
+              << std::thread::hardware_concurrency() << " hardware threads\n\n"
+              << std::setw(10) << "workers"
+              << std::setw(12) << "ms"
+              << std::setw(10) << "speedup"
+              << std::setw(10) << "reissued"
+              << '\n';
+
+    double one = 0;
+
+    auto const report = [&](char const* name, DistributedStats const& stats)
+    {
+        if (one == 0)
+            one = stats.ms;
+
+        std::cout << std::fixed << std::setprecision(1)
+                  << std::setw(10) << name
+                  << std::setw(12) << stats.ms
+                  << std::setw(10) << one / stats.ms
+                  << std::setw(10) << stats.reissued
+                  << std::endl;
+    };
+
+    for (int const workers : {1, 2, 4, 8})
+        report(std::to_string(workers).c_str(), run(job, workers));
+
+    // One of four workers drops out after 20 tiles.
+    report("4, 1 dies", run(job, 4, 1));
+}
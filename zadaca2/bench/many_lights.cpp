@@ -0,0 +1,190 @@
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+
+#include <random>
+#include <vector>
+
+#include <linear_algebra.h>
+
+#include <objects/object.h>
+#include <objects/sphere.h>
+#include <objects/cylinder.h>
+#include <objects/cuboid.h>
+
+#include <lights/point_light.h>
+#include <lights/light_tree.h>
+#include <lights/point_light_array.h>
+
+#include <rays/ray.h>
+#include <rays/tracing.h>
+
+#include <rendering/camera.h>
+
+/*
+** Renders the main scene with a growing number of point lights and
+** compares the plain per-light loop against the SIMD light array and
+** the light tree, both with exact traversal, with threshold pruning
+** and with a few stochastic light samples per shading point.
+**
+** The total intensity is kept constant, so every row renders roughly
+** the same image and the error against the exhaustive loop is
+** comparable between rows.
+*/
+
+// Tracing every 24th pixel of the full frame gives an 80x45 image with
+// the same framing and sampling positions as the main render.
+constexpr auto width  = 1920;
+constexpr auto height = 1080;
+constexpr auto stride = 24;
+
+template <typename Lights>
+std::vector<float3> render_sparse(
+    std::vector<Object const*> const& objects,
+    MaterialTable              const& materials,
+    Lights                     const& lights)
+{
+    Camera const camera = default_camera(width, height);
+    auto const rays = make_camera_rays(camera, width, height);
+
+    std::vector<float3> image;
+
+    for (int j = 0; j < height; j += stride)
+    {
+        for (int i = 0; i < width; i += stride)
+        {
+            image.push_back(
+                trace<16>(primary_ray(rays, i, j), objects, materials, lights)
+            );
+        }
+    }
+
+    return image;
+}
+
+template <typename F>
+double milliseconds(F&& f)
+{
+    auto const start = std::chrono::steady_clock::now();
+    f();
+    auto const end   = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+double rms_error(
+    std::vector<float3> const& image,
+    std::vector<float3> const& reference)
+{
+    double sum = 0;
+
+    for (std::size_t i = 0; i < image.size(); ++i)
+    {
+        float3 const d = image[i] - reference[i];
+        sum += d.dot(d) / 3;
+    }
+
+    return std::sqrt(sum / image.size());
+}
+
+std::vector<PointLight> make_lights(int const count)
+{
+    std::vector<PointLight> lights = {
+        { {-20, -149, -50}, 1.4 },
+        { {-35,  120, 0}  , 2   },
+        { {150,  180, 20} , 1   },
+    };
+    lights.resize(std::min<std::size_t>(lights.size(), count));
+
+    // Fixed seed, so every run benchmarks the same lights.
+    std::mt19937 engine{42};
+    std::uniform_real_distribution<float> x{-600,  600};
+    std::uniform_real_distribution<float> y{-300,  400};
+    std::uniform_real_distribution<float> z{-900,  100};
+
+    while (static_cast<int>(lights.size()) < count)
+    {
+        lights.push_back({ {x(engine), y(engine), z(engine)}, 1 });
+    }
+
+    float total = 0;
+    for (auto const& light : lights)
+        total += light.intensity;
+
+    for (auto& light : lights)
+        light.intensity *= 4.4f / total;
+
+    return lights;
+}
+
+int main()
+{
+    MaterialTable const materials = {
+        { {255,  24,  24}, 0.6, 0.3, 60, 0.4 },
+        { { 24, 100,  24}, 0.6, 0.3, 60, 0.4 },
+        { { 24,  24, 100}, 0.6, 0.3, 60, 0.4 },
+        { {255, 255, 255}, 0.6, 0.3, 60, 0.4 },
+    };
+
+    Cuboid   const floor(3, {-1000, -200, 0}, {1000, -150, -800});
+    Sphere   const s1   (1, {0, -90, -350}, 60);
+    Cylinder const v1   (0, {150, -150, -400}, 25, 65);
+    Cuboid   const c1   (2, {-200, -149, -300}, {-125, -76, -375});
+
+    std::vector<Object const*> const objects = {&floor, &s1, &v1, &c1};
+
+    std::cout << width / stride << 'x' << height / stride << " pixels, times in ms, "
+              << "error is RMS against the exhaustive loop\n\n";
+
+    std::cout << std::setw(8)  << "lights"
+              << std::setw(12) << "loop"
+              << std::setw(12) << "simd"
+              << std::setw(12) << "tree"
+              << std::setw(12) << "pruned"
+              << std::setw(10) << "error"
+              << std::setw(12) << "sampled"
+              << std::setw(10) << "error"
+              << '\n';
+
+    for (int const count : {3, 10, 30, 100, 300, 1000, 3000, 10000})
+    {
+        auto const lights = make_lights(count);
+
+        auto const array   = make_point_light_array(lights);
+        auto const exact   = build_light_tree(lights);
+        // Prune clusters that can't add a twentieth of an average light.
+        auto const pruned  = build_light_tree(lights, 0.05f * 4.4f / count);
+        auto const sampled = build_light_tree(lights, 0, 4);
+
+        std::vector<float3> reference, image_array, image_exact, image_pruned, image_sampled;
+
+        auto const t_loop    = milliseconds([&] {
+            reference     = render_sparse(objects, materials, lights);
+        });
+        auto const t_array   = milliseconds([&] {
+            image_array   = render_sparse(objects, materials, array);
+        });
+        auto const t_exact   = milliseconds([&] {
+            image_exact   = render_sparse(objects, materials, exact);
+        });
+        auto const t_pruned  = milliseconds([&] {
+            image_pruned  = render_sparse(objects, materials, pruned);
+        });
+        auto const t_sampled = milliseconds([&] {
+            image_sampled = render_sparse(objects, materials, sampled);
+        });
+
+        std::cout << std::fixed << std::setprecision(1)
+                  << std::setw(8)  << count
+                  << std::setw(12) << t_loop
+                  << std::setw(12) << t_array
+                  << std::setw(12) << t_exact
+                  << std::setw(12) << t_pruned
+                  << std::setw(10) << rms_error(image_pruned, reference)
+                  << std::setw(12) << t_sampled
+                  << std::setw(10) << rms_error(image_sampled, reference)
+                  << std::endl;
+    }
+}
@@ -0,0 +1,126 @@
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <lights/shadow_culled_lights.h>
+
+#include <output/tiled_image.h>
+
+#include <rendering/camera.h>
+#include <rendering/render_cache.h>
+#include <rendering/tiled_render.h>
+
+#include <scenes/scene_file.h>
+#include <scenes/scene_replicas.h>
+
+#include <threading/thread_pool.h>
+#include <threading/work_stealing_pool.h>
+
+/*
+** Throughput of the main scene rendered into a tiled image by the
+** shared queue pool, by the work stealing pool unpinned with one copy
+** of the scene, and by the work stealing pool pinned to NUMA nodes with
+** a copy of the scene on each, all with the same number of threads.
+**
+** Each is the best of three runs. On a single node machine pinning only
+** keeps threads from migrating between cores; the difference the
+** replicas and local tiles make needs two sockets or more.
+**
+**      bench_numa_scheduling [width] [height] [tile size]
+*/
+
+int main(int argc, char** argv)
+{
+    int const width     = argc > 1 ? std::stoi(argv[1]) : 1920;
+    int const height    = argc > 2 ? std::stoi(argv[2]) : 1080;
+    int const tile_size = argc > 3 ? std::stoi(argv[3]) : 64;
+
+    std::string const path = "/tmp/zadaca2-bench-numa.tiles";
+
+    std::ifstream scene_input("../scenes/kugle.scene");
+
+    if (not scene_input)
+    {
+        std::cerr << "run from the build directory, next to ../scenes\n";
+        return 1;
+    }
+
+    auto const text   = read_file("../scenes/kugle.scene");
+    auto       input  = std::istringstream(text);
+    auto const scene  = parse_scene(input);
+    auto const lights = build_shadow_culled_lights(scene.lights, scene.objects);
+
+    Camera const camera = default_camera(width, height);
+
+    auto image = create_tiled_image(path, width, height, tile_size);
+
+    auto const best_of_3 = [&](auto&& render)
+    {
+        double best = 0;
+
+        for (int run = 0; run < 3; ++run)
+        {
+            auto const start = std::chrono::steady_clock::now();
+            render();
+
+            double const ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            best = run == 0 ? ms : std::min(best, ms);
+        }
+
+        return best;
+    };
+
+    ThreadPool       shared;
+    WorkStealingPool unpinned(shared.size(), false);
+    WorkStealingPool pinned(shared.size(), true);
+
+    auto const one_copy = replicate_scene(unpinned, text);
+    auto const per_node = replicate_scene(pinned, text);
+
+    std::cout << width << 'x' << height << ", " << tile_size << 'x' << tile_size << " tiles, "
+              << shared.size() << " threads, " << pinned.node_count() << " NUMA "
+              << (pinned.node_count() == 1 ? "node" : "nodes") << ":";
+
+    for (auto const& node : pinned.nodes())
+        std::cout << ' ' << node.id << " (" << node.cpus.size() << " CPUs)";
+
+    std::cout << "\n\n"
+              << std::setw(34) << "pool"
+              << std::setw(12) << "ms"
+              << std::setw(16) << "Mpixel/s"
+              << '\n';
+
+    auto const report = [&](char const* name, double const ms)
+    {
+        std::cout << std::fixed << std::setprecision(1)
+                  << std::setw(34) << name
+                  << std::setw(12) << ms
+                  << std::setw(16) << width * static_cast<double>(height) / (ms * 1000)
+                  << std::endl;
+    };
+
+    report("shared queue", best_of_3([&]
+    {
+        render_tiled(shared, camera, image, scene.objects, scene.materials, lights);
+    }));
+
+    report("work stealing, unpinned", best_of_3([&]
+    {
+        render_tiled(unpinned, camera, image, one_copy);
+    }));
+
+    report("work stealing, pinned per node", best_of_3([&]
+    {
+        render_tiled(pinned, camera, image, per_node);
+    }));
+
+    std::remove(path.c_str());
+}
@@ -0,0 +1,135 @@
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <linear_algebra.h>
+
+#include <objects/object.h>
+#include <objects/sphere.h>
+#include <objects/cylinder.h>
+#include <objects/cuboid.h>
+
+#include <lights/point_light.h>
+
+#include <rendering/camera.h>
+#include <rendering/gbuffer.h>
+#include <rendering/rasterization.h>
+
+/*
+** Primary visibility by casting a camera ray per pixel against the
+** whole scene, against rasterizing the primitives into the G-buffer,
+** for the main scene with a growing number of extra spheres. Both
+** frames are then shaded by relight(), so the frame times differ only
+** in how primary hits were found.
+*/
+
+constexpr auto width  = 1920;
+constexpr auto height = 1080;
+
+template <typename F>
+double milliseconds(F&& f)
+{
+    auto const start = std::chrono::steady_clock::now();
+    f();
+    auto const end   = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// Pixels whose primary hit differs between the two G-buffers.
+std::size_t mismatches(
+    GBuffer const& a,
+    GBuffer const& b)
+{
+    std::size_t count = 0;
+
+    for (std::size_t i = 0; i < a.samples.size(); ++i)
+    {
+        count += a.samples[i].object   != b.samples[i].object
+              or a.samples[i].distance != b.samples[i].distance;
+    }
+
+    return count;
+}
+
+int main()
+{
+    MaterialTable const materials = {
+        { {255,  24,  24}, 0.6, 0.3, 60, 0.4 },
+        { { 24, 100,  24}, 0.6, 0.3, 60, 0.4 },
+        { { 24,  24, 100}, 0.6, 0.3, 60, 0.4 },
+        { {255, 255, 255}, 0.6, 0.3, 60, 0.4 },
+    };
+
+    std::vector<PointLight> const lights = {
+        { {-20, -149, -50}, 1.4 },
+        { {-35,  120, 0}  , 2   },
+        { {150,  180, 20} , 1   },
+    };
+
+    Camera const camera = default_camera(width, height);
+
+    Cuboid   const floor(3, {-1000, -200, 0}, {1000, -150, -800});
+    Sphere   const s1   (1, {0, -90, -350}, 60);
+    Cylinder const v1   (0, {150, -150, -400}, 25, 65);
+    Cuboid   const c1   (2, {-200, -149, -300}, {-125, -76, -375});
+
+    // Fixed seed, so every run benchmarks the same scene.
+    std::mt19937 engine{42};
+    std::uniform_real_distribution<float> x{-400,  400};
+    std::uniform_real_distribution<float> z{-780, -250};
+    std::uniform_int_distribution<MaterialIndex> material{0, 2};
+
+    std::vector<std::unique_ptr<Sphere>> spheres;
+
+    std::cout << width << 'x' << height << ", times in ms\n\n";
+
+    std::cout << std::setw(8)  << "objects"
+              << std::setw(12) << "traced"
+              << std::setw(12) << "raster"
+              << std::setw(12) << "mismatch"
+              << std::setw(14) << "traced frame"
+              << std::setw(14) << "hybrid frame"
+              << '\n';
+
+    for (int const extra : {0, 16, 64, 256})
+    {
+        while (static_cast<int>(spheres.size()) < extra)
+        {
+            spheres.push_back(std::make_unique<Sphere>(
+                material(engine), float3{x(engine), -138, z(engine)}, 12
+            ));
+        }
+
+        std::vector<Object const*> objects = {&floor, &s1, &v1, &c1};
+        for (auto const& sphere : spheres)
+            objects.push_back(sphere.get());
+
+        GBuffer traced, rasterized;
+
+        auto const t_traced = milliseconds([&] {
+            traced     = render_gbuffer<width, height>(camera, objects);
+        });
+        auto const t_raster = milliseconds([&] {
+            rasterized = rasterize_gbuffer<width, height>(camera, objects);
+        });
+        auto const t_shade  = milliseconds([&] {
+            auto const image = relight<width, height>(rasterized, objects, materials, lights);
+        });
+
+        std::cout << std::fixed << std::setprecision(1)
+                  << std::setw(8)  << objects.size()
+                  << std::setw(12) << t_traced
+                  << std::setw(12) << t_raster
+                  << std::setw(12) << mismatches(traced, rasterized)
+                  << std::setw(14) << t_traced + t_shade
+                  << std::setw(14) << t_raster + t_shade
+                  << std::endl;
+    }
+}
@@ -0,0 +1,178 @@
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+
+#include <numbers>
+#include <vector>
+
+#include <linear_algebra.h>
+
+#include <sampling/sampler.h>
+
+/*
+** Convergence of the sample sequences on integrands that look like
+** what the renderer will ask for: a disk seen through the unit square
+** is the visibility of a spherical light, a product of two disks is
+** that light's visibility times an occlusion term in two more
+** dimensions. The disk's radius changes smoothly over the image, so
+** neighbouring pixels integrate nearly the same function, the way
+** neighbouring pixels of a render do.
+**
+** "blurred" is the RMS error after a 3x3 box filter: white noise only
+** drops to a third under it, while blue noise, which keeps its error in
+** the high frequencies, drops a lot further. It is what remains of the
+** error after a denoiser or after the eye has averaged it.
+*/
+
+constexpr auto width  = 256;
+constexpr auto height = 256;
+
+struct Errors
+{
+    double rms     {};
+    double blurred {};
+    double ns      {};
+};
+
+[[nodiscard]]
+float radius_at(int const x, int const y)
+{
+    return 0.15f + 0.3f * (x + y) / (width + height);
+}
+
+[[nodiscard]]
+float disk(float2 const u, float const r)
+{
+    float const dx = u.x - 0.5f;
+    float const dy = u.y - 0.5f;
+
+    return dx * dx + dy * dy < r * r ? 1.f : 0.f;
+}
+
+Errors measure(
+    SampleSequence const sequence,
+    int            const samples,
+    int            const dimensions)
+{
+    Sampler const sampler
+    {
+        .sequence          = sequence,
+        .samples_per_pixel = samples,
+        .seed              = 7,
+        .width             = width,
+        .height            = height,
+    };
+
+    std::vector<double> error(width * height);
+
+    auto const start = std::chrono::steady_clock::now();
+
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            float const r     = radius_at(x, y);
+            float const area  = std::numbers::pi_v<float> * r * r;
+            float const truth = dimensions == 2 ? area : area * area;
+
+            double sum = 0;
+
+            for (int s = 0; s < samples; ++s)
+            {
+                auto pixel = start_pixel_sample(sampler, x, y, s);
+
+                float value = disk(pixel.next_2d(), r);
+
+                if (dimensions == 4)
+                    value *= disk(pixel.next_2d(), r);
+
+                sum += value;
+            }
+
+            error[y * width + x] = sum / samples - truth;
+        }
+    }
+
+    auto const end = std::chrono::steady_clock::now();
+
+    double squared         = 0;
+    double blurred_squared = 0;
+
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            squared += error[y * width + x] * error[y * width + x];
+
+            double blurred = 0;
+
+            for (int dy = -1; dy <= 1; ++dy)
+            {
+                for (int dx = -1; dx <= 1; ++dx)
+                {
+                    int const qx = std::clamp(x + dx, 0, width  - 1);
+                    int const qy = std::clamp(y + dy, 0, height - 1);
+
+                    blurred += error[qy * width + qx] / 9;
+                }
+            }
+
+            blurred_squared += blurred * blurred;
+        }
+    }
+
+    return {
+        .rms     = std::sqrt(squared / (width * height)),
+        .blurred = std::sqrt(blurred_squared / (width * height)),
+        .ns      = std::chrono::duration<double, std::nano>(end - start).count()
+                 / (static_cast<double>(width) * height * samples * dimensions / 2),
+    };
+}
+
+int main()
+{
+    struct Entry
+    {
+        char const*    name;
+        SampleSequence sequence;
+    };
+
+    Entry const entries[] = {
+        {"independent", SampleSequence::independent     },
+        {"halton"     , SampleSequence::halton          },
+        {"sobol"      , SampleSequence::sobol           },
+        {"blue noise" , SampleSequence::blue_noise_sobol},
+    };
+
+    std::cout << width << 'x' << height << " pixels, RMS error x1000, "
+              << "ns per 2D sample\n";
+
+    for (int const dimensions : {2, 4})
+    {
+        std::cout << '\n' << dimensions << " dimensions\n"
+                  << std::setw(12) << "sequence"
+                  << std::setw(6)  << "spp"
+                  << std::setw(10) << "rms"
+                  << std::setw(10) << "blurred"
+                  << std::setw(8)  << "ns"
+                  << '\n';
+
+        for (auto const& entry : entries)
+        {
+            for (int const samples : {1, 4, 16, 64})
+            {
+                auto const errors = measure(entry.sequence, samples, dimensions);
+
+                std::cout << std::fixed << std::setprecision(1)
+                          << std::setw(12) << entry.name
+                          << std::setw(6)  << samples
+                          << std::setw(10) << 1000 * errors.rms
+                          << std::setw(10) << 1000 * errors.blurred
+                          << std::setw(8)  << errors.ns
+                          << '\n';
+            }
+        }
+    }
+}
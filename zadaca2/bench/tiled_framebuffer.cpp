@@ -0,0 +1,119 @@
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <lights/shadow_culled_lights.h>
+
+#include <output/tiled_image.h>
+
+#include <rendering/camera.h>
+#include <rendering/tiled_render.h>
+
+#include <scenes/scene_file.h>
+
+#include <threading/thread_pool.h>
+
+/*
+** Peak resident memory of frames rendered into a tiled image, from a
+** few megapixels up to a 64K x 32K poster (2 gigapixels, a 6 GiB file),
+** next to what the frame would take as one std::vector<float3>.
+**
+** The scene is a single matte sphere under one light, cheap enough that
+** the biggest frame renders in minutes; memory doesn't depend on the
+** scene. Peak RSS is reset between frames through
+** /proc/self/clear_refs, so this is Linux only.
+**
+**      bench_tiled_framebuffer [largest width] [file]
+*/
+
+constexpr char scene_text[] = R"(
+material grey 200 200 200  0.8 0.2 20 0
+sphere   grey   0 0 -400  150
+light    -200 200 0  1.5
+)";
+
+// The named field of /proc/self/status, in MiB.
+double status_mib(std::string const& field)
+{
+    std::ifstream status("/proc/self/status");
+    std::string   line;
+
+    while (std::getline(status, line))
+    {
+        if (line.starts_with(field + ':'))
+            return std::stod(line.substr(field.size() + 1)) / 1024;
+    }
+
+    return 0;
+}
+
+void reset_peak_rss()
+{
+    std::ofstream("/proc/self/clear_refs") << "5";
+}
+
+int main(int argc, char** argv)
+{
+    int         const largest = argc > 1 ? std::stoi(argv[1]) : 65536;
+    std::string const path    = argc > 2 ? argv[2] : "/tmp/zadaca2-bench-tiled.tiles";
+
+    std::istringstream text(scene_text);
+
+    auto const scene  = parse_scene(text);
+    auto const lights = build_shadow_culled_lights(scene.lights, scene.objects);
+
+    ThreadPool pool;
+
+    std::cout << "256x256 tiles, " << pool.size() << " threads, "
+              << "RSS before rendering " << std::fixed << std::setprecision(1)
+              << status_mib("VmRSS") << " MiB\n\n"
+              << std::setw(14) << "frame"
+              << std::setw(12) << "megapixels"
+              << std::setw(12) << "file MiB"
+              << std::setw(16) << "vector MiB"
+              << std::setw(16) << "peak RSS MiB"
+              << std::setw(12) << "s"
+              << '\n';
+
+    for (int width = 4096; width <= largest; width *= 4)
+    {
+        int const height = width / 2;
+
+        reset_peak_rss();
+
+        auto const start = std::chrono::steady_clock::now();
+
+        {
+            auto image = create_tiled_image(path, width, height, 256);
+
+            Camera const camera
+            {
+                .horizontal_fov = 1.2f,
+                .aspect_ratio   = static_cast<float>(width) / height,
+            };
+
+            render_tiled(pool, camera, image, scene.objects, scene.materials, lights);
+        }
+
+        double const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double const pixels  = static_cast<double>(width) * height;
+
+        std::cout << std::setw(14) << (std::to_string(width) + 'x' + std::to_string(height))
+                  << std::setw(12) << pixels / 1e6
+                  << std::setw(12) << std::filesystem::file_size(path) / 1048576.0
+                  << std::setw(16) << pixels * sizeof(float3) / 1048576
+                  << std::setw(16) << status_mib("VmHWM")
+                  << std::setw(12) << seconds
+                  << std::endl;
+
+        std::filesystem::remove(path);
+    }
+}
@@ -0,0 +1,305 @@
+#ifndef LIGHTS_AREA_LIGHTS_H
+#define LIGHTS_AREA_LIGHTS_H
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <numbers>
+#include <vector>
+
+#include <linear_algebra.h>
+#include <objects/object.h>
+#include <lights/point_light.h>
+#include <rays/ray.h>
+#include <rays/shading.h>
+#include <sampling/sampler.h>
+
+/*
+** Rectangular and spherical lights, which cast soft shadows.
+**
+** Shading treats an area light as a point light at its centre, and
+** only its visibility, the fraction of its surface a point can see, is
+** estimated with shadow rays. Most points see all or nothing of a
+** light, so they start with a few rays and only points where those
+** disagree, in the penumbra, keep doubling the count up to a limit.
+*/
+struct AreaLight
+{
+    enum class Shape
+    {
+        rectangle,
+        sphere,
+    };
+
+    Shape  shape     {};
+    float3 center    {};
+    // The rectangle's sides, centred on `center`.
+    float3 edge_u    {};
+    float3 edge_v    {};
+    float  radius    {};
+    float  intensity {};
+};
+
+[[nodiscard]]
+constexpr AreaLight make_rectangle_light(
+    float3 const center,
+    float3 const edge_u,
+    float3 const edge_v,
+    float  const intensity)
+{
+    return {
+        .shape     = AreaLight::Shape::rectangle,
+        .center    = center,
+        .edge_u    = edge_u,
+        .edge_v    = edge_v,
+        .radius    = 0,
+        .intensity = intensity,
+    };
+}
+
+[[nodiscard]]
+constexpr AreaLight make_sphere_light(
+    float3 const center,
+    float  const radius,
+    float  const intensity)
+{
+    return {
+        .shape     = AreaLight::Shape::sphere,
+        .center    = center,
+        .edge_u    = {},
+        .edge_v    = {},
+        .radius    = radius,
+        .intensity = intensity,
+    };
+}
+
+[[nodiscard]]
+constexpr BoundingBox light_bounds(AreaLight const& light)
+{
+    if (light.shape == AreaLight::Shape::sphere)
+    {
+        float3 const r = {light.radius, light.radius, light.radius};
+        return {light.center - r, light.center + r};
+    }
+
+    float3 const corner = light.center - 0.5 * (light.edge_u + light.edge_v);
+
+    return BoundingBox{corner, corner}
+        .expand(corner + light.edge_u)
+        .expand(corner + light.edge_v)
+        .expand(corner + light.edge_u + light.edge_v);
+}
+
+/*
+** The part of the light that p samples: the rectangle itself, or for a
+** sphere the disk through its centre that faces p, which is what p
+** sees of it as long as the sphere is small next to its distance.
+*/
+struct LightSamplingFrame
+{
+    AreaLight::Shape shape  {};
+    float3           center {};
+    float3           u      {};
+    float3           v      {};
+};
+
+[[nodiscard]]
+inline LightSamplingFrame light_sampling_frame(
+    AreaLight const& light,
+    float3    const  p)
+{
+    if (light.shape == AreaLight::Shape::rectangle)
+        return {light.shape, light.center, light.edge_u, light.edge_v};
+
+    float3 const w      = (light.center - p).normalize();
+    float3 const helper = std::abs(w.x) < 0.9f ? float3{1, 0, 0} : float3{0, 1, 0};
+    float3 const s      = w.cross(helper).normalize();
+    float3 const t      = w.cross(s);
+
+    return {light.shape, light.center, light.radius * s, light.radius * t};
+}
+
+// A point of the frame for u in [0, 1)^2, uniform over its area.
+[[nodiscard]]
+inline float3 sample_light_frame(
+    LightSamplingFrame const& frame,
+    float2             const  u)
+{
+    if (frame.shape == AreaLight::Shape::rectangle)
+        return frame.center + (u.x - 0.5f) * frame.u + (u.y - 0.5f) * frame.v;
+
+    float const r   = std::sqrt(u.x);
+    float const phi = 2 * std::numbers::pi_v<float> * u.y;
+
+    return frame.center + r * std::cos(phi) * frame.u + r * std::sin(phi) * frame.v;
+}
+
+struct AreaShadowSettings
+{
+    // Rays every point starts with; powers of two keep the Sobol
+    // prefixes stratified.
+    int initial_samples = 4;
+    // Penumbra points double their rays until they reach this.
+    int max_samples     = 64;
+};
+
+struct AreaLights
+{
+    std::vector<AreaLight>     lights   {};
+    // The scene's primitives and their bounds, to find possible
+    // occluders without tracing.
+    std::vector<Object const*> objects  {};
+    std::vector<BoundingBox>   bounds   {};
+    AreaShadowSettings         settings {};
+};
+
+template <typename Scene> [[nodiscard]]
+AreaLights build_area_lights(
+    std::vector<AreaLight> const& lights,
+    Scene                  const& scene,
+    AreaShadowSettings     const  settings = {})
+{
+    AreaLights area
+    {
+        .lights   = lights,
+        .objects  = scene_objects(scene),
+        .bounds   = {},
+        .settings = settings,
+    };
+
+    for (auto const* object : area.objects)
+        area.bounds.push_back(object->bounding_box());
+
+    return area;
+}
+
+/*
+** Fraction of the light that p, on the surface of receiver, can see.
+**
+** Only objects overlapping the box around p and the light can block
+** any of its shadow rays. The receiver itself is left out only when it
+** is a closed convex solid and the whole light is in front of p, since
+** then every shadow ray leaves its surface outwards and can't come
+** back; an open cylinder can shadow itself from the inside, and any
+** primitive can shadow a point facing away from the light. If no
+** object is left the light is fully visible without tracing at all,
+** otherwise rays are tested against those objects alone and stop at
+** the first hit.
+*/
+[[nodiscard]]
+inline float area_light_visibility(
+    float3        const  p,
+    float3        const  n,
+    Object const* const  receiver,
+    std::size_t   const  light,
+    AreaLights    const& lights)
+{
+    auto const& area   = lights.lights[light];
+    auto const  bounds = light_bounds(area);
+    auto const  hull   = bounds.expand(p);
+
+    bool in_front = true;
+
+    for (int corner = 0; corner < 8; ++corner)
+    {
+        float3 const q = {
+            corner & 1 ? bounds.max.x : bounds.min.x,
+            corner & 2 ? bounds.max.y : bounds.min.y,
+            corner & 4 ? bounds.max.z : bounds.min.z,
+        };
+
+        in_front = in_front and n.dot(q - p) > 0;
+    }
+
+    Object const* const skipped = in_front and receiver->closed_convex() ? receiver : nullptr;
+
+    thread_local std::vector<Object const*> candidates;
+    candidates.clear();
+
+    for (std::size_t k = 0; k < lights.objects.size(); ++k)
+    {
+        if (lights.objects[k] != skipped and lights.bounds[k].overlaps(hull))
+            candidates.push_back(lights.objects[k]);
+    }
+
+    if (candidates.empty())
+        return 1;
+
+    // Seeded by the point itself, like the light tree's sampling, so the
+    // result doesn't depend on the order points are shaded in.
+    std::uint64_t seed = mix_bits(light);
+    for (float const f : {p.x, p.y, p.z})
+        seed = hash_sample(seed, std::bit_cast<std::uint32_t>(f));
+
+    auto const frame = light_sampling_frame(area, p);
+
+    int taken   = 0;
+    int blocked = 0;
+
+    auto const trace = [&](int const count)
+    {
+        for (int const end = taken + count; taken < end; ++taken)
+        {
+            float3 const q = sample_light_frame(
+                frame, scrambled_sobol_2d(static_cast<std::uint32_t>(taken), seed)
+            );
+            auto const shadow_ray = make_shadow_ray(p, n, PointLight{q, 0});
+
+            for (auto const* object : candidates)
+            {
+                if (blocks_shadow_ray(object, shadow_ray))
+                {
+                    ++blocked;
+                    break;
+                }
+            }
+        }
+    };
+
+    trace(std::max(1, lights.settings.initial_samples));
+
+    while (blocked != 0 and blocked != taken and taken < lights.settings.max_samples)
+        trace(taken);
+
+    return 1 - static_cast<float>(blocked) / static_cast<float>(taken);
+}
+
+template <typename Scene> [[nodiscard]]
+float3 shade(
+    Ray                         const  ray,
+    Object::RayIntersectionData const  data,
+    // Occluders come from the lights' own copy of the scene.
+    Scene                       const& /* objects */,
+    MaterialTable               const& materials,
+    AreaLights                  const& lights)
+{
+    Material const material = materials[data.intersected_object->material];
+
+    float3 const p = data.intersection_point;
+    float3 const n = data.intersection_normal;
+
+    LightContribution total {};
+
+    for (std::size_t i = 0; i < lights.lights.size(); ++i)
+    {
+        auto const& light = lights.lights[i];
+
+        float const visibility = area_light_visibility(p, n, data.intersected_object, i, lights);
+
+        if (visibility == 0)
+            continue;
+
+        auto const contribution = light_terms(
+            ray, data, material, PointLight{light.center, light.intensity}
+        );
+
+        total.diffuse  += visibility * contribution.diffuse;
+        total.specular += visibility * contribution.specular;
+    }
+
+    return combine_light(material, total);
+}
+
+#endif // LIGHTS_AREA_LIGHTS_H
@@ -0,0 +1,346 @@
+#ifndef LIGHTS_LIGHT_TREE_H
+#define LIGHTS_LIGHT_TREE_H
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <linear_algebra.h>
+#include <objects/object.h>
+#include <lights/point_light.h>
+#include <rays/ray.h>
+#include <rays/shading.h>
+
+/*
+** Bounding volume hierarchy over point lights, for scenes with far
+** more lights than we can afford shadow rays for.
+**
+** Every node bounds the positions of the lights below it and stores
+** their summed intensity, which is enough to bound how much a whole
+** cluster can contribute to a shading point without visiting it.
+** Nodes are laid out depth first, so the left child of an inner node
+** is always the node right after it.
+*/
+struct LightTree
+{
+    struct Node
+    {
+        float3        min         {};
+        float3        max         {};
+        float         intensity   {};
+        std::uint32_t first_light {};
+        std::uint32_t light_count {}; // Zero for inner nodes.
+        std::uint32_t right_child {};
+    };
+
+    std::vector<PointLight> lights {};
+    std::vector<Node>       nodes  {};
+
+    // Clusters whose contribution bound is below this are skipped.
+    float threshold {};
+    // Lights sampled per shading point, or 0 to visit every light
+    // that survives the threshold.
+    int   samples   {};
+};
+
+inline std::uint32_t build_light_tree_node(
+    LightTree&          tree,
+    std::uint32_t const first,
+    std::uint32_t const count)
+{
+    auto const index = static_cast<std::uint32_t>(tree.nodes.size());
+    auto const begin = tree.lights.begin() + first;
+    auto const end   = begin + count;
+
+    LightTree::Node node
+    {
+        .min = begin->position,
+        .max = begin->position,
+    };
+
+    for (auto it = begin; it != end; ++it)
+    {
+        float3 const p = it->position;
+
+        node.min = {
+            std::min(node.min.x, p.x), std::min(node.min.y, p.y), std::min(node.min.z, p.z)
+        };
+        node.max = {
+            std::max(node.max.x, p.x), std::max(node.max.y, p.y), std::max(node.max.z, p.z)
+        };
+        node.intensity += it->intensity;
+    }
+
+    tree.nodes.push_back(node);
+
+    if (count == 1)
+    {
+        tree.nodes[index].first_light = first;
+        tree.nodes[index].light_count = 1;
+        return index;
+    }
+
+    // Median split along the longest axis of the bounds.
+    float3 const extent = node.max - node.min;
+    auto const axis = extent.x >= extent.y and extent.x >= extent.z ? &float3::x
+                    : extent.y >= extent.z                         ? &float3::y
+                    :                                                &float3::z;
+
+    auto const half = count / 2;
+
+    std::nth_element(begin, begin + half, end,
+        [axis](PointLight const& a, PointLight const& b)
+        {
+            return a.position.*axis < b.position.*axis;
+        }
+    );
+
+    build_light_tree_node(tree, first, half);
+    auto const right = build_light_tree_node(tree, first + half, count - half);
+    tree.nodes[index].right_child = right;
+
+    return index;
+}
+
+[[nodiscard]]
+inline LightTree build_light_tree(
+    std::vector<PointLight>       lights,
+    float                   const threshold = 0,
+    int                     const samples   = 0)
+{
+    LightTree tree
+    {
+        .lights    = std::move(lights),
+        .nodes     = {},
+        .threshold = threshold,
+        .samples   = samples,
+    };
+
+    if (not tree.lights.empty())
+    {
+        tree.nodes.reserve(2 * tree.lights.size() - 1);
+        build_light_tree_node(tree, 0, static_cast<std::uint32_t>(tree.lights.size()));
+    }
+
+    return tree;
+}
+
+/*
+** Upper bound of the shading terms for any light inside the node.
+**
+** The node's box is wrapped in a sphere, which subtends a cone of
+** half-angle alpha as seen from p. If the angle between the normal
+** and the cone axis is theta, no light in the node can be closer to
+** the normal than theta - alpha, so the Lambert cosine is at most
+**
+**      cos(max(0, theta - alpha)).
+**
+** The Blinn-Phong term needs a bound of its own: the half vector lies
+** halfway between the light and the view direction v, so a light
+** behind the surface can still have a highlight when v is grazing.
+** With theta_v the angle between v and the normal, the half vector is
+** at least (theta - alpha - theta_v) / 2 from the normal, which bounds
+** the specular cosine the same way. Leaving it out would make sampling
+** never pick lights behind the surface and lose their highlights.
+**
+** The shading model has no distance falloff, so the larger of the two,
+** times the summed intensity, bounds the whole cluster's contribution.
+*/
+[[nodiscard]]
+inline float light_node_importance(
+    LightTree::Node const& node,
+    float3          const  p,
+    float3          const  n,
+    float3          const  v,
+    Material        const& material)
+{
+    float3 const center = 0.5 * (node.min + node.max);
+    float  const radius = 0.5 * (node.max - node.min).length();
+
+    float3 const to_center = center - p;
+    float  const distance  = to_center.length();
+
+    if (distance <= radius)
+        return node.intensity;
+
+    float const cos_theta = std::clamp(to_center.dot(n) / distance, -1.f, 1.f);
+    float const alpha     = std::asin(radius / distance);
+    float const closest   = std::max(0.f, std::acos(cos_theta) - alpha);
+
+    float bound = std::cos(std::min(closest, 1.5707964f));
+
+    if (material.specular_coefficient > 0)
+    {
+        float const theta_v = std::acos(std::clamp(v.dot(n), -1.f, 1.f));
+        float const half    = std::max(0.f, closest - theta_v) / 2;
+
+        bound = std::max(bound, std::pow(std::cos(half), material.specular_exponent));
+    }
+
+    return node.intensity * std::max(0.f, bound);
+}
+
+/*
+** Small hash based generator. It is seeded from the shading point
+** itself, so the light picked for a point doesn't depend on which
+** thread or in which order the point was shaded.
+*/
+struct LightSampleGenerator
+{
+    std::uint32_t state {};
+
+    [[nodiscard]]
+    constexpr float next() noexcept
+    {
+        // PCG-RXS-M-XS, 32 bit.
+        state = state * 747796405u + 2891336453u;
+        std::uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+        word = (word >> 22u) ^ word;
+
+        return static_cast<float>(word >> 8) * 0x1p-24f;
+    }
+};
+
+[[nodiscard]]
+inline LightSampleGenerator seed_light_sample_generator(
+    Ray    const ray,
+    float3 const p)
+{
+    std::uint32_t seed = 0x9e3779b9u;
+
+    for (float const f : {p.x, p.y, p.z, ray.direction.x, ray.direction.y, ray.direction.z})
+    {
+        seed ^= std::bit_cast<std::uint32_t>(f) + 0x9e3779b9u + (seed << 6) + (seed >> 2);
+    }
+
+    return {seed};
+}
+
+template <typename Scene> [[nodiscard]]
+float3 shade(
+    Ray                         const  ray,
+    Object::RayIntersectionData const  data,
+    Scene                       const& objects,
+    MaterialTable               const& materials,
+    LightTree                   const& lights)
+{
+    Material const material = materials[data.intersected_object->material];
+
+    float3 const p = data.intersection_point;
+    float3 const n = data.intersection_normal;
+    float3 const v = (ray.source - p).normalize();
+
+    LightContribution total {};
+
+    if (lights.nodes.empty())
+        return combine_light(material, total);
+
+    // Contribution bound of a node, or 0 if it falls under the threshold.
+    auto const importance = [&](std::uint32_t const index)
+    {
+        float const bound = light_node_importance(lights.nodes[index], p, n, v, material);
+        return bound < lights.threshold ? 0.f : bound;
+    };
+
+    if (lights.samples == 0)
+    {
+        // Exact traversal, pruning clusters below the threshold.
+        std::uint32_t stack[64];
+        int           top = 0;
+
+        stack[top++] = 0;
+
+        while (top > 0)
+        {
+            auto const  index = stack[--top];
+            auto const& node  = lights.nodes[index];
+
+            if (light_node_importance(node, p, n, v, material) < lights.threshold)
+                continue;
+
+            if (node.light_count > 0)
+            {
+                for (auto i = node.first_light; i < node.first_light + node.light_count; ++i)
+                {
+                    auto const contribution
+                        = illuminate(ray, data, objects, material, lights.lights[i]);
+
+                    total.diffuse  += contribution.diffuse;
+                    total.specular += contribution.specular;
+                }
+            }
+            else
+            {
+                stack[top++] = node.right_child;
+                stack[top++] = index + 1;
+            }
+        }
+
+        return combine_light(material, total);
+    }
+
+    /*
+    ** Stochastic mode: walk down the tree choosing each child with
+    ** probability proportional to its importance, and weight the
+    ** picked light by the inverse of the probability of picking it.
+    ** This is an unbiased estimate of the sum over all lights the
+    ** importance doesn't rule out, at a cost independent of their
+    ** number.
+    */
+    auto generator = seed_light_sample_generator(ray, p);
+
+    for (int sample = 0; sample < lights.samples; ++sample)
+    {
+        std::uint32_t index = 0;
+        float         pdf   = 1;
+
+        while (lights.nodes[index].light_count == 0)
+        {
+            auto const left  = index + 1;
+            auto const right = lights.nodes[index].right_child;
+
+            float const left_importance  = importance(left);
+            float const right_importance = importance(right);
+            float const sum              = left_importance + right_importance;
+
+            if (sum <= 0)
+            {
+                pdf = 0;
+                break;
+            }
+
+            float const p_left = left_importance / sum;
+
+            if (generator.next() < p_left)
+            {
+                index = left;
+                pdf  *= p_left;
+            }
+            else
+            {
+                index = right;
+                pdf  *= 1 - p_left;
+            }
+        }
+
+        if (pdf <= 0)
+            continue;
+
+        auto const& leaf   = lights.nodes[index];
+        float const weight = 1 / (pdf * lights.samples);
+
+        auto const contribution = illuminate(
+            ray, data, objects, material, lights.lights[leaf.first_light]
+        );
+
+        total.diffuse  += weight * contribution.diffuse;
+        total.specular += weight * contribution.specular;
+    }
+
+    return combine_light(material, total);
+}
+
+#endif // LIGHTS_LIGHT_TREE_H
@@ -0,0 +1,245 @@
+#ifndef LIGHTS_POINT_LIGHT_ARRAY_H
+#define LIGHTS_POINT_LIGHT_ARRAY_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <immintrin.h>
+#define POINT_LIGHT_ARRAY_SSE 1
+#endif
+
+#include <linear_algebra.h>
+#include <objects/object.h>
+#include <lights/point_light.h>
+#include <rays/ray.h>
+#include <rays/shading.h>
+
+/*
+** Point lights stored as a structure of arrays, so the Lambert and
+** Blinn-Phong terms can be evaluated for a whole block of lights at
+** once. The arrays are padded to a multiple of the block width with
+** zero intensity lights, which contribute nothing and never cost a
+** shadow ray.
+*/
+struct PointLightArray
+{
+    static constexpr std::size_t block = 4;
+
+    std::vector<float> x         {};
+    std::vector<float> y         {};
+    std::vector<float> z         {};
+    std::vector<float> intensity {};
+
+    [[nodiscard]]
+    std::size_t size() const noexcept
+    {
+        return intensity.size();
+    }
+
+    [[nodiscard]]
+    PointLight operator[](std::size_t const i) const noexcept
+    {
+        return {{x[i], y[i], z[i]}, intensity[i]};
+    }
+};
+
+[[nodiscard]]
+inline PointLightArray make_point_light_array(std::vector<PointLight> const& lights)
+{
+    auto const padded = (lights.size() + PointLightArray::block - 1)
+                      / PointLightArray::block * PointLightArray::block;
+
+    PointLightArray array;
+    array.x        .resize(padded);
+    array.y        .resize(padded);
+    array.z        .resize(padded);
+    array.intensity.resize(padded);
+
+    for (std::size_t i = 0; i < lights.size(); ++i)
+    {
+        array.x[i]         = lights[i].position.x;
+        array.y[i]         = lights[i].position.y;
+        array.z[i]         = lights[i].position.z;
+        array.intensity[i] = lights[i].intensity;
+    }
+
+    return array;
+}
+
+/*
+** Lambert and Blinn-Phong terms for one block of lights, before any
+** shadowing. The view direction doesn't depend on the light, so the
+** caller normalizes it once per shading point.
+*/
+struct LightBlockTerms
+{
+    float diffuse  [PointLightArray::block] {};
+    float specular [PointLightArray::block] {};
+};
+
+[[nodiscard]]
+inline LightBlockTerms evaluate_light_block(
+    PointLightArray const& lights,
+    std::size_t     const  first,
+    float3          const  p,
+    float3          const  n,
+    float3          const  view_direction,
+    float           const  exponent,
+    int             const  integer_exponent)
+{
+    LightBlockTerms terms;
+
+#ifdef POINT_LIGHT_ARRAY_SSE
+    __m128 const one  = _mm_set1_ps(1);
+    __m128 const zero = _mm_setzero_ps();
+
+    __m128 const dx = _mm_sub_ps(_mm_loadu_ps(&lights.x[first]), _mm_set1_ps(p.x));
+    __m128 const dy = _mm_sub_ps(_mm_loadu_ps(&lights.y[first]), _mm_set1_ps(p.y));
+    __m128 const dz = _mm_sub_ps(_mm_loadu_ps(&lights.z[first]), _mm_set1_ps(p.z));
+    __m128 const intensity = _mm_loadu_ps(&lights.intensity[first]);
+
+    // Light direction, normalized.
+    __m128 const inverse_distance = _mm_div_ps(one, _mm_sqrt_ps(
+        _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz))
+    ));
+    __m128 const lx = _mm_mul_ps(dx, inverse_distance);
+    __m128 const ly = _mm_mul_ps(dy, inverse_distance);
+    __m128 const lz = _mm_mul_ps(dz, inverse_distance);
+
+    __m128 const nx = _mm_set1_ps(n.x);
+    __m128 const ny = _mm_set1_ps(n.y);
+    __m128 const nz = _mm_set1_ps(n.z);
+
+    __m128 const cos_light = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(lx, nx), _mm_mul_ps(ly, ny)), _mm_mul_ps(lz, nz)
+    );
+    _mm_storeu_ps(terms.diffuse, _mm_mul_ps(intensity, _mm_max_ps(zero, cos_light)));
+
+    // Half vector, normalized.
+    __m128 const hx = _mm_add_ps(lx, _mm_set1_ps(view_direction.x));
+    __m128 const hy = _mm_add_ps(ly, _mm_set1_ps(view_direction.y));
+    __m128 const hz = _mm_add_ps(lz, _mm_set1_ps(view_direction.z));
+
+    __m128 const half_length = _mm_sqrt_ps(
+        _mm_add_ps(_mm_add_ps(_mm_mul_ps(hx, hx), _mm_mul_ps(hy, hy)), _mm_mul_ps(hz, hz))
+    );
+    __m128 const cos_half = _mm_max_ps(zero, _mm_div_ps(
+        _mm_add_ps(_mm_add_ps(_mm_mul_ps(hx, nx), _mm_mul_ps(hy, ny)), _mm_mul_ps(hz, nz)),
+        half_length
+    ));
+
+    if (integer_exponent >= 0)
+    {
+        // Exponentiation by squaring, all lanes at once.
+        __m128 power = one;
+        __m128 base  = cos_half;
+
+        for (int e = integer_exponent; e > 0; e >>= 1)
+        {
+            if (e & 1)
+                power = _mm_mul_ps(power, base);
+            base = _mm_mul_ps(base, base);
+        }
+
+        _mm_storeu_ps(terms.specular, _mm_mul_ps(intensity, power));
+    }
+    else
+    {
+        _mm_storeu_ps(terms.specular, cos_half);
+
+        for (std::size_t i = 0; i < PointLightArray::block; ++i)
+        {
+            terms.specular[i] = lights.intensity[first + i]
+                              * std::pow(terms.specular[i], exponent);
+        }
+    }
+#else
+    for (std::size_t i = 0; i < PointLightArray::block; ++i)
+    {
+        auto const light = lights[first + i];
+
+        if (light.intensity == 0)
+            continue;
+
+        auto const light_direction = (light.position - p).normalize();
+        auto const half_vector     = (light_direction + view_direction).normalize();
+        auto const cos_half        = std::max(0.f, half_vector.dot(n));
+
+        float power = 1;
+
+        if (integer_exponent >= 0)
+        {
+            float base = cos_half;
+
+            for (int e = integer_exponent; e > 0; e >>= 1)
+            {
+                if (e & 1)
+                    power *= base;
+                base *= base;
+            }
+        }
+        else
+        {
+            power = std::pow(cos_half, exponent);
+        }
+
+        terms.diffuse [i] = lambert_model(light, light_direction, n);
+        terms.specular[i] = light.intensity * power;
+    }
+#endif
+
+    return terms;
+}
+
+template <typename Scene> [[nodiscard]]
+float3 shade(
+    Ray                         const  ray,
+    Object::RayIntersectionData const  data,
+    Scene                       const& objects,
+    MaterialTable               const& materials,
+    PointLightArray             const& lights)
+{
+    Material const material = materials[data.intersected_object->material];
+
+    float3 const p = data.intersection_point;
+    float3 const n = data.intersection_normal;
+
+    // Everything that doesn't depend on the light is done once.
+    float3 const view_direction = (ray.source - p).normalize();
+
+    float const exponent         = material.specular_exponent;
+    int   const integer_exponent =
+        exponent >= 0 and exponent <= 1024 and exponent == std::floor(exponent)
+        ? static_cast<int>(exponent)
+        : -1;
+
+    LightContribution total {};
+
+    for (std::size_t first = 0; first < lights.size(); first += PointLightArray::block)
+    {
+        auto const terms = evaluate_light_block(
+            lights, first, p, n, view_direction, exponent, integer_exponent
+        );
+
+        for (std::size_t i = 0; i < PointLightArray::block; ++i)
+        {
+            // Padding, or nothing to gain from a shadow ray.
+            if (lights.intensity[first + i] == 0
+                or (terms.diffuse[i] == 0 and terms.specular[i] == 0))
+                continue;
+
+            if (is_in_shadow(p, n, lights[first + i], objects))
+                continue;
+
+            total.diffuse  += terms.diffuse [i];
+            total.specular += terms.specular[i];
+        }
+    }
+
+    return combine_light(material, total);
+}
+
+#endif // LIGHTS_POINT_LIGHT_ARRAY_H
@@ -0,0 +1,175 @@
+#ifndef LIGHTS_SHADOW_CULLED_LIGHTS_H
+#define LIGHTS_SHADOW_CULLED_LIGHTS_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include <linear_algebra.h>
+#include <objects/object.h>
+#include <lights/point_light.h>
+#include <rays/ray.h>
+#include <rays/shading.h>
+
+/*
+** Point lights with precomputed shadow caster lists.
+**
+** A shadow ray from a point on a receiver R towards a light L stays
+** inside the convex hull of L and R, so only objects that overlap that
+** hull can ever block it. We approximate the hull with the bounding
+** box of L and R's bounding box, which is conservative, and keep one
+** caster list per (light, receiver) pair.
+*/
+struct ShadowCulledLights
+{
+    // Unique per build, so per-thread caches can tell sets apart.
+    std::uint64_t id {};
+
+    std::vector<PointLight> lights {};
+
+    // Scene objects sorted by address, to find a receiver's index.
+    std::vector<Object const*> receivers {};
+
+    // casters[light * receivers.size() + receiver]
+    std::vector<std::vector<Object const*>> casters {};
+};
+
+[[nodiscard]]
+inline ShadowCulledLights build_shadow_culled_lights(
+    std::vector<PointLight>    const& lights,
+    std::vector<Object const*> const& objects)
+{
+    static std::atomic<std::uint64_t> next_id = 1;
+
+    ShadowCulledLights culled
+    {
+        .id        = next_id++,
+        .lights    = lights,
+        .receivers = objects,
+        .casters   = {},
+    };
+
+    std::sort(culled.receivers.begin(), culled.receivers.end());
+    culled.casters.reserve(lights.size() * objects.size());
+
+    for (auto const light : lights)
+    {
+        for (auto const* receiver : culled.receivers)
+        {
+            auto const hull = receiver->bounding_box().expand(light.position);
+
+            auto& casters = culled.casters.emplace_back();
+
+            for (auto const* object : objects)
+            {
+                if (object->bounding_box().overlaps(hull))
+                    casters.push_back(object);
+            }
+        }
+    }
+
+    return culled;
+}
+
+template <typename Scene> [[nodiscard]]
+ShadowCulledLights build_shadow_culled_lights(
+    std::vector<PointLight> const& lights,
+    Scene                   const& objects)
+{
+    return build_shadow_culled_lights(lights, scene_objects(objects));
+}
+
+/*
+** Neighbouring pixels are usually shadowed by the same object, so each
+** thread remembers the last blocker it found for every light and tries
+** it before the caster list. The cache belongs to one set of lights at
+** a time and is dropped when a different one is used.
+*/
+struct LastOccluderCache
+{
+    std::uint64_t              owner     {};
+    std::vector<Object const*> occluders {};
+};
+
+[[nodiscard]]
+inline LastOccluderCache& last_occluder_cache(ShadowCulledLights const& lights)
+{
+    thread_local LastOccluderCache cache;
+
+    if (cache.owner != lights.id)
+    {
+        cache.owner = lights.id;
+        cache.occluders.assign(lights.lights.size(), nullptr);
+    }
+
+    return cache;
+}
+
+[[nodiscard]]
+inline bool is_in_shadow(
+    float3             const  p,
+    float3             const  n,
+    std::size_t        const  light,
+    Object const*      const  receiver,
+    ShadowCulledLights const& lights)
+{
+    auto const shadow_ray = make_shadow_ray(p, n, lights.lights[light]);
+
+    auto& cache = last_occluder_cache(lights);
+    auto& last  = cache.occluders[light];
+
+    if (last and blocks_shadow_ray(last, shadow_ray))
+        return true;
+
+    auto const it = std::lower_bound(
+        lights.receivers.begin(), lights.receivers.end(), receiver
+    );
+    auto const receiver_index = static_cast<std::size_t>(it - lights.receivers.begin());
+    auto const& casters
+        = lights.casters[light * lights.receivers.size() + receiver_index];
+
+    for (auto const* object : casters)
+    {
+        if (object != last and blocks_shadow_ray(object, shadow_ray))
+        {
+            last = object;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+template <typename Scene> [[nodiscard]]
+float3 shade(
+    Ray                         const  ray,
+    Object::RayIntersectionData const  data,
+    // Shadows come from the caster lists instead.
+    Scene                       const& /* objects */,
+    MaterialTable               const& materials,
+    ShadowCulledLights          const& lights)
+{
+    Material const material = materials[data.intersected_object->material];
+
+    float3 const p = data.intersection_point;
+    float3 const n = data.intersection_normal;
+
+    LightContribution total {};
+
+    for (std::size_t i = 0; i < lights.lights.size(); ++i)
+    {
+        if (is_in_shadow(p, n, i, data.intersected_object, lights))
+            continue;
+
+        auto const contribution
+            = light_terms(ray, data, material, lights.lights[i]);
+
+        total.diffuse  += contribution.diffuse;
+        total.specular += contribution.specular;
+    }
+
+    return combine_light(material, total);
+}
+
+#endif // LIGHTS_SHADOW_CULLED_LIGHTS_H
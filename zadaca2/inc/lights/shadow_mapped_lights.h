@@ -0,0 +1,264 @@
+#ifndef LIGHTS_SHADOW_MAPPED_LIGHTS_H
+#define LIGHTS_SHADOW_MAPPED_LIGHTS_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#include <linear_algebra.h>
+#include <objects/object.h>
+#include <lights/point_light.h>
+#include <rays/ray.h>
+#include <rays/shading.h>
+#include <threading/parallel_for.h>
+
+struct ShadowMapSettings
+{
+    // Texels along one edge of every cube face.
+    int   resolution    = 512;
+    // Depth bias in scene units, plus a part that grows with the texel
+    // footprint on surfaces seen at a grazing angle.
+    float constant_bias = 0.5;
+    float slope_bias    = 1;
+    // Percentage closer filtering over (2 * filter_radius + 1)^2 texels;
+    // 0 gives hard, single tap shadows.
+    int   filter_radius = 1;
+};
+
+/*
+** Distance from a point light to the nearest surface, stored for
+** every direction around it on the six faces of a cube.
+**
+** A direction d whose largest component is along axis a falls on face
+** 2a (positive) or 2a + 1 (negative), at coordinates
+**
+**      s = d[a + 1] / |d[a]|,  t = d[a + 2] / |d[a]|     (mod 3)
+**
+** both in [-1, 1].
+*/
+struct CubeShadowMap
+{
+    int                resolution {};
+    std::vector<float> depth      {}; // [face][t][s]
+
+    [[nodiscard]]
+    float at(int const face, int const s, int const t) const noexcept
+    {
+        return depth[(face * resolution + t) * resolution + s];
+    }
+};
+
+struct CubeMapTexel
+{
+    int   face {};
+    float s    {}; // In texels, not yet rounded.
+    float t    {};
+};
+
+[[nodiscard]]
+constexpr float axis_component(float3 const v, int const axis)
+{
+    return axis == 0 ? v.x : axis == 1 ? v.y : v.z;
+}
+
+[[nodiscard]]
+inline CubeMapTexel cube_map_texel(float3 const d, int const resolution)
+{
+    using std::abs;
+
+    int const axis = abs(d.x) >= abs(d.y) and abs(d.x) >= abs(d.z) ? 0
+                   : abs(d.y) >= abs(d.z)                          ? 1
+                   :                                                 2;
+
+    float const major = axis_component(d, axis);
+    float const s     = axis_component(d, (axis + 1) % 3) / abs(major);
+    float const t     = axis_component(d, (axis + 2) % 3) / abs(major);
+
+    return {
+        .face = 2 * axis + (major < 0 ? 1 : 0),
+        .s    = (s + 1) / 2 * resolution,
+        .t    = (t + 1) / 2 * resolution,
+    };
+}
+
+[[nodiscard]]
+constexpr float3 cube_map_direction(
+    int   const face,
+    float const s,
+    float const t)
+{
+    int   const axis = face / 2;
+    float const sign = face % 2 == 0 ? 1 : -1;
+
+    switch (axis)
+    {
+        case 0:  return float3{sign, s, t}.normalize();
+        case 1:  return float3{t, sign, s}.normalize();
+        default: return float3{s, t, sign}.normalize();
+    }
+}
+
+template <typename Scene> [[nodiscard]]
+CubeShadowMap render_cube_shadow_map(
+    PointLight const  light,
+    Scene      const& objects,
+    int        const  resolution)
+{
+    CubeShadowMap map
+    {
+        .resolution = resolution,
+        .depth      = std::vector<float>(6 * resolution * resolution),
+    };
+
+    // One row of one face per task.
+    parallel_for(6 * resolution, [&](std::size_t const row)
+    {
+        int const face = static_cast<int>(row) / resolution;
+        int const t    = static_cast<int>(row) % resolution;
+
+        for (int s = 0; s < resolution; ++s)
+        {
+            // Through the texel center.
+            float const u = (s + 0.5f) / resolution * 2 - 1;
+            float const v = (t + 0.5f) / resolution * 2 - 1;
+
+            auto const data = get_nearest_ray_intersection_data(
+                Ray{light.position, cube_map_direction(face, u, v)},
+                objects
+            );
+
+            map.depth[row * resolution + s] = data.intersected_object
+                ? data.intersection_distance
+                : std::numeric_limits<float>::infinity();
+        }
+    });
+
+    return map;
+}
+
+/*
+** Point lights whose visibility is answered from precomputed cube
+** shadow maps instead of shadow rays. Only valid while neither the
+** lights nor the geometry move; the memory cost is fixed at
+** 6 * resolution^2 floats per light.
+*/
+struct ShadowMappedLights
+{
+    std::vector<PointLight>    lights   {};
+    std::vector<CubeShadowMap> maps     {};
+    ShadowMapSettings          settings {};
+};
+
+template <typename Scene> [[nodiscard]]
+ShadowMappedLights build_shadow_mapped_lights(
+    std::vector<PointLight> const& lights,
+    Scene                   const& objects,
+    ShadowMapSettings       const  settings = {})
+{
+    ShadowMappedLights mapped
+    {
+        .lights   = lights,
+        .maps     = {},
+        .settings = settings,
+    };
+
+    for (auto const light : lights)
+    {
+        mapped.maps.push_back(
+            render_cube_shadow_map(light, objects, settings.resolution)
+        );
+    }
+
+    return mapped;
+}
+
+/*
+** Fraction of the filter footprint around p that the light reaches,
+** from 0 (fully shadowed) to 1 (fully lit).
+*/
+[[nodiscard]]
+inline float shadow_map_visibility(
+    float3             const  p,
+    float3             const  n,
+    std::size_t        const  light,
+    ShadowMappedLights const& lights)
+{
+    auto const& map      = lights.maps[light];
+    auto const& settings = lights.settings;
+
+    float3 const to_point = p - lights.lights[light].position;
+    float  const distance = to_point.length();
+
+    int const r = settings.filter_radius;
+
+    /*
+    ** A texel covers about 2d / resolution scene units at distance d,
+    ** and a surface tilted away from the light by theta spans tan(theta)
+    ** times that in depth within one texel. The filter reaches r texels
+    ** further out, so the bias has to cover those as well.
+    */
+    float const cos_theta = std::clamp(std::abs(to_point.dot(n)) / distance, 0.05f, 1.f);
+    float const tan_theta = std::sqrt(1 - cos_theta * cos_theta) / cos_theta;
+    float const texel     = 2 * distance / map.resolution;
+    float const bias      = settings.constant_bias
+                          + settings.slope_bias * (r + 1) * texel * tan_theta;
+
+    auto const texel_coordinates = cube_map_texel(to_point, map.resolution);
+    int  const s0 = static_cast<int>(texel_coordinates.s);
+    int  const t0 = static_cast<int>(texel_coordinates.t);
+
+    int lit   = 0;
+    int total = 0;
+
+    // Taps falling off the face are clamped to its edge.
+    for (int dt = -r; dt <= r; ++dt)
+    {
+        for (int ds = -r; ds <= r; ++ds)
+        {
+            int const s = std::clamp(s0 + ds, 0, map.resolution - 1);
+            int const t = std::clamp(t0 + dt, 0, map.resolution - 1);
+
+            lit   += distance - bias <= map.at(texel_coordinates.face, s, t);
+            total += 1;
+        }
+    }
+
+    return static_cast<float>(lit) / total;
+}
+
+template <typename Scene> [[nodiscard]]
+float3 shade(
+    Ray                         const  ray,
+    Object::RayIntersectionData const  data,
+    // Shadows come from the maps instead.
+    Scene                       const& /* objects */,
+    MaterialTable               const& materials,
+    ShadowMappedLights          const& lights)
+{
+    Material const material = materials[data.intersected_object->material];
+
+    float3 const p = data.intersection_point;
+    float3 const n = data.intersection_normal;
+
+    LightContribution total {};
+
+    for (std::size_t i = 0; i < lights.lights.size(); ++i)
+    {
+        float const visibility = shadow_map_visibility(p, n, i, lights);
+
+        if (visibility == 0)
+            continue;
+
+        auto const contribution
+            = light_terms(ray, data, material, lights.lights[i]);
+
+        total.diffuse  += visibility * contribution.diffuse;
+        total.specular += visibility * contribution.specular;
+    }
+
+    return combine_light(material, total);
+}
+
+#endif // LIGHTS_SHADOW_MAPPED_LIGHTS_H
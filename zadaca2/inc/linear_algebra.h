@@ -128,7 +128,7 @@ struct float3
         return {
             .x = y * rhs.z - z * rhs.y,
             .y = z * rhs.x - x * rhs.z,
-            .z = x * rhs.y - y * rhs.z,
+            .z = x * rhs.y - y * rhs.x,
         };
     }
 };
@@ -3,6 +3,7 @@
 
 #include <algorithm>
 #include <limits>
+#include <string>
 
 #include <linear_algebra.h>
 #include <objects/object.h>
@@ -14,9 +15,9 @@ struct Cuboid final : public Object
     float3 v2;
 
     constexpr Cuboid(
-        Material const mat,
-        float3   const v1,
-        float3   const v2)
+        MaterialIndex const mat,
+        float3        const v1,
+        float3        const v2)
         : v1{v1}
         , v2{v2}
     {
@@ -126,6 +127,29 @@ struct Cuboid final : public Object
         else if (abs(point.z - v2.z) < 0.01) return { 0,  0,  1};
         else                                 return { 0,  0,  0};
     }
+
+    [[nodiscard]]
+    constexpr BoundingBox bounding_box() const noexcept final
+    {
+        return {
+            .min = {std::min(v1.x, v2.x), std::min(v1.y, v2.y), std::min(v1.z, v2.z)},
+            .max = {std::max(v1.x, v2.x), std::max(v1.y, v2.y), std::max(v1.z, v2.z)},
+        };
+    }
+
+    [[nodiscard]]
+    constexpr bool closed_convex() const noexcept final
+    {
+        return true;
+    }
+
+    // The corners aren't reordered: normal() tells faces apart by
+    // which corner they pass through.
+    [[nodiscard]]
+    std::string canonical_form() const final
+    {
+        return canonical_record("cuboid", {v1.x, v1.y, v1.z, v2.x, v2.y, v2.z});
+    }
 };
 
 #endif // CUBOID_H
@@ -1,6 +1,8 @@
 #ifndef CYLINER_H
 #define CYLINER_H
 
+#include <string>
+
 #include <linear_algebra.h>
 #include <objects/object.h>
 #include <rays/ray.h>
@@ -12,10 +14,10 @@ struct Cylinder final : public Object
     float  height {};
 
     constexpr Cylinder(
-        Material const mat,
-        float3   const center,
-        float    const radius,
-        float    const height)
+        MaterialIndex const mat,
+        float3        const center,
+        float         const radius,
+        float         const height)
         : center{center}
         , radius{radius}
         , height{height}
@@ -77,6 +79,28 @@ struct Cylinder final : public Object
 
         return v.normalize();
     }
+
+    [[nodiscard]]
+    constexpr BoundingBox bounding_box() const noexcept final
+    {
+        return {
+            .min = {center.x - radius, center.y         , center.z - radius},
+            .max = {center.x + radius, center.y + height, center.z + radius},
+        };
+    }
+
+    // An open tube: a ray leaving its inner wall can hit the wall across.
+    [[nodiscard]]
+    constexpr bool closed_convex() const noexcept final
+    {
+        return false;
+    }
+
+    [[nodiscard]]
+    std::string canonical_form() const final
+    {
+        return canonical_record("cylinder", {center.x, center.y, center.z, radius, height});
+    }
 };
 
 #endif // CYLINDER_H
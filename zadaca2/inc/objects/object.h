@@ -1,6 +1,15 @@
 #ifndef OBJECT_H
 #define OBJECT_H
 
+#include <algorithm>
+#include <cstdint>
+#include <initializer_list>
+#include <ios>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
 #include <linear_algebra.h>
 #include <rays/ray.h>
 
@@ -10,6 +19,35 @@ struct Material
     float diffuse_coefficient  {};
     float specular_coefficient {};
     float specular_exponent    {};
+    // Weight of the mirror reflection; 0 means no reflected ray is traced.
+    float reflectivity         {};
+};
+
+// Materials are shared between primitives, which refer to them by index.
+using MaterialIndex = std::uint32_t;
+using MaterialTable = std::vector<Material>;
+
+struct BoundingBox
+{
+    float3 min {};
+    float3 max {};
+
+    [[nodiscard]]
+    constexpr bool overlaps(BoundingBox const other) const noexcept
+    {
+        return min.x <= other.max.x and other.min.x <= max.x
+           and min.y <= other.max.y and other.min.y <= max.y
+           and min.z <= other.max.z and other.min.z <= max.z;
+    }
+
+    [[nodiscard]]
+    constexpr BoundingBox expand(float3 const point) const noexcept
+    {
+        return {
+            .min = {std::min(min.x, point.x), std::min(min.y, point.y), std::min(min.z, point.z)},
+            .max = {std::max(max.x, point.x), std::max(max.y, point.y), std::max(max.z, point.z)},
+        };
+    }
 };
 
 struct Object
@@ -22,12 +60,40 @@ struct Object
         float3 intersection_normal       {};
     };
 
-    Material material {};
+    MaterialIndex material {};
 
     virtual RayIntersectionData get_ray_intersection_data(Ray    const ray  ) const = 0;
     virtual float3              normal                   (float3 const point) const = 0;
+    virtual BoundingBox         bounding_box             (                  ) const = 0;
+
+    // Kind and parameters of the primitive, equal for any two primitives
+    // with the same shape; what the render cache hashes.
+    virtual std::string         canonical_form           (                  ) const = 0;
+
+    // Whether the primitive is a closed convex solid, which no ray
+    // leaving its surface outwards can hit again.
+    virtual bool                closed_convex            (                  ) const = 0;
 };
 
+/*
+** A primitive's canonical form: its kind followed by its parameters in
+** hexadecimal floating point, which prints every float exactly and
+** each value one way only (negative zero is written as zero).
+*/
+[[nodiscard]]
+inline std::string canonical_record(
+    std::string_view             const kind,
+    std::initializer_list<float> const values)
+{
+    std::ostringstream record;
+    record << kind << std::hexfloat;
+
+    for (float const value : values)
+        record << ' ' << (value == 0 ? 0.f : value);
+
+    return record.str();
+}
+
 [[nodiscard]]
 Object::RayIntersectionData get_nearest_ray_intersection_data(
     Ray                        const  ray,
@@ -55,4 +121,12 @@ Object::RayIntersectionData get_nearest_ray_intersection_data(
     return nearest_intersection_data;
 }
 
+// The primitives of a scene as plain pointers, whatever its layout.
+[[nodiscard]]
+inline std::vector<Object const*> scene_objects(
+    std::vector<Object const*> const& objects)
+{
+    return objects;
+}
+
 #endif // OBJECT_H
@@ -1,6 +1,8 @@
 #ifndef SPHERE_H
 #define SPHERE_H
 
+#include <string>
+
 #include <linear_algebra.h>
 #include <objects/object.h>
 
@@ -10,9 +12,9 @@ struct Sphere final : public Object
     float  radius {};
 
     constexpr Sphere(
-        Material const mat,
-        float3   const center,
-        float    const radius)
+        MaterialIndex const mat,
+        float3        const center,
+        float         const radius)
         : center{center}
         , radius{radius}
     {
@@ -93,6 +95,26 @@ struct Sphere final : public Object
     {
         return (point - center).normalize();
     }
+
+    [[nodiscard]]
+    constexpr BoundingBox bounding_box() const noexcept final
+    {
+        float3 const r = {radius, radius, radius};
+
+        return {center - r, center + r};
+    }
+
+    [[nodiscard]]
+    constexpr bool closed_convex() const noexcept final
+    {
+        return true;
+    }
+
+    [[nodiscard]]
+    std::string canonical_form() const final
+    {
+        return canonical_record("sphere", {center.x, center.y, center.z, radius});
+    }
 };
 
 #endif // SPHERE_H
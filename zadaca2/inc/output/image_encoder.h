@@ -0,0 +1,440 @@
+#ifndef OUTPUT_IMAGE_ENCODER_H
+#define OUTPUT_IMAGE_ENCODER_H
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <immintrin.h>
+#define IMAGE_ENCODER_SSE 1
+#endif
+
+#include <linear_algebra.h>
+
+/*
+** Writing images while they are being rendered.
+**
+** The renderer hands finished bands of rows to an ImageEncoder, which
+** copies them and returns at once. A thread of the encoder's own
+** converts them and appends them to the file as soon as the rows above
+** them are in, so by the time the last band is rendered nearly all of
+** the image is already on disk.
+**
+** The format follows the file's extension:
+**
+**      .ppm    binary PPM, 8 bits per channel
+**      .png    8 bit RGB PNG, deflate in stored blocks (no compression,
+**              so no zlib), one IDAT chunk per band
+**      .pfm    little endian float PFM, colours scaled to [0, 1], which
+**              keeps everything 8 bit formats round away
+*/
+enum class ImageFormat
+{
+    ppm,
+    png,
+    pfm,
+};
+
+[[nodiscard]]
+inline ImageFormat image_format(std::filesystem::path const& path)
+{
+    auto const extension = path.extension();
+
+    if (extension == ".png")
+        return ImageFormat::png;
+    if (extension == ".pfm")
+        return ImageFormat::pfm;
+
+    return ImageFormat::ppm;
+}
+
+struct EncoderSettings
+{
+    /*
+    ** Ordered (4x4 Bayer) dithering when going to 8 bits, which breaks
+    ** up the banding of smooth gradients. Without it channels are
+    ** truncated, as they always have been.
+    */
+    bool dither = false;
+};
+
+/*
+** Thresholds of a 4x4 Bayer matrix, (rank + 1/2) / 16. Adding one to a
+** value before truncating rounds it up with a probability equal to its
+** fractional part, averaged over the tile.
+*/
+constexpr float bayer_4x4[4][4] =
+{
+    { 0.5f / 16,  8.5f / 16,  2.5f / 16, 10.5f / 16},
+    {12.5f / 16,  4.5f / 16, 14.5f / 16,  6.5f / 16},
+    { 3.5f / 16, 11.5f / 16,  1.5f / 16,  9.5f / 16},
+    {15.5f / 16,  7.5f / 16, 13.5f / 16,  5.5f / 16},
+};
+
+/*
+** values[k] + offsets[k], clamped to [0, 255] and truncated to 8 bits,
+** for count channels.
+*/
+inline void quantize_channels(
+    float const*   const values,
+    float const*   const offsets,
+    std::size_t    const count,
+    unsigned char* const out)
+{
+    std::size_t k = 0;
+
+#ifdef IMAGE_ENCODER_SSE
+    __m128 const zero = _mm_setzero_ps();
+    __m128 const top  = _mm_set1_ps(255);
+
+    auto const convert = [&](std::size_t const at)
+    {
+        __m128 const v = _mm_add_ps(_mm_loadu_ps(values + at), _mm_loadu_ps(offsets + at));
+        return _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(v, zero), top));
+    };
+
+    for (; k + 16 <= count; k += 16)
+    {
+        __m128i const low  = _mm_packs_epi32(convert(k    ), convert(k +  4));
+        __m128i const high = _mm_packs_epi32(convert(k + 8), convert(k + 12));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + k), _mm_packus_epi16(low, high));
+    }
+#endif
+
+    for (; k < count; ++k)
+        out[k] = static_cast<unsigned char>(std::clamp(values[k] + offsets[k], 0.f, 255.f));
+}
+
+class ImageEncoder
+{
+public:
+    ImageEncoder(
+        std::filesystem::path const& path,
+        int                   const  width,
+        int                   const  height,
+        EncoderSettings       const  settings = {})
+        : width_   {width}
+        , height_  {height}
+        , format_  {image_format(path)}
+        , file_    {path, std::ofstream::binary}
+        , offsets_ (4, std::vector<float>(3 * width, 0))
+    {
+        if (settings.dither)
+        {
+            for (int j = 0; j < 4; ++j)
+                for (int i = 0; i < 3 * width; ++i)
+                    offsets_[j][i] = bayer_4x4[j][(i / 3) % 4];
+        }
+
+        write_header();
+
+        thread_ = std::jthread([this] { run(); });
+    }
+
+    ImageEncoder(ImageEncoder const&)            = delete;
+    ImageEncoder& operator=(ImageEncoder const&) = delete;
+
+    ~ImageEncoder()
+    {
+        finish();
+    }
+
+    // Queues rows [first, first + count), copied from pixels.
+    void submit(
+        int           const first,
+        int           const count,
+        float3 const* const pixels)
+    {
+        {
+            std::lock_guard const lock(mutex_);
+            queue_.emplace_back(first, std::vector<float3>(pixels, pixels + count * width_));
+        }
+
+        ready_.notify_one();
+    }
+
+    // Waits until every submitted row is in the file, and closes it.
+    void finish()
+    {
+        {
+            std::lock_guard const lock(mutex_);
+            closing_ = true;
+        }
+
+        ready_.notify_one();
+
+        if (thread_.joinable())
+            thread_.join();
+    }
+
+private:
+    void run()
+    {
+        // Bands that arrived before the rows above them, by first row.
+        std::map<int, std::vector<float3>> early;
+
+        while (true)
+        {
+            std::deque<std::pair<int, std::vector<float3>>> bands;
+            bool                                            closing;
+
+            {
+                std::unique_lock lock(mutex_);
+                ready_.wait(lock, [&] { return closing_ or not queue_.empty(); });
+
+                bands.swap(queue_);
+                closing = closing_;
+            }
+
+            for (auto& [first, pixels] : bands)
+                early.emplace(first, std::move(pixels));
+
+            for (auto band = early.begin(); band != early.end() and band->first == next_row_; band = early.erase(band))
+                write_rows(band->first, static_cast<int>(band->second.size()) / width_, band->second.data());
+
+            if (closing)
+                break;
+        }
+
+        write_footer();
+        file_.close();
+    }
+
+    void write_header()
+    {
+        std::string const size = std::to_string(width_) + ' ' + std::to_string(height_);
+
+        switch (format_)
+        {
+        case ImageFormat::ppm:
+            file_ << "P6\n" << size << "\n255\n";
+            break;
+
+        case ImageFormat::pfm:
+            // A negative scale means little endian.
+            file_ << "PF\n" << size << "\n-1.0\n";
+            pfm_data_ = file_.tellp();
+            break;
+
+        case ImageFormat::png:
+        {
+            file_.write("\x89PNG\r\n\x1a\n", 8);
+
+            std::string header;
+            append_big_endian(header, static_cast<std::uint32_t>(width_));
+            append_big_endian(header, static_cast<std::uint32_t>(height_));
+            header += std::string("\x08\x02\x00\x00\x00", 5); // 8 bit RGB.
+
+            write_png_chunk("IHDR", header);
+            break;
+        }
+        }
+    }
+
+    void write_rows(
+        int           const first,
+        int           const count,
+        float3 const* const pixels)
+    {
+        next_row_ = first + count;
+
+        auto const channels = static_cast<std::size_t>(3 * width_);
+        auto const values   = reinterpret_cast<float const*>(pixels);
+
+        switch (format_)
+        {
+        case ImageFormat::ppm:
+        {
+            bytes_.resize(channels * count);
+
+            for (int j = 0; j < count; ++j)
+            {
+                quantize_channels(values + j * channels, offsets_[(first + j) % 4].data(), channels,
+                    reinterpret_cast<unsigned char*>(bytes_.data()) + j * channels
+                );
+            }
+
+            file_.write(bytes_.data(), static_cast<std::streamsize>(bytes_.size()));
+            break;
+        }
+
+        case ImageFormat::pfm:
+        {
+            // PFM stores the bottom row first.
+            std::vector<float> row(channels);
+
+            for (int j = 0; j < count; ++j)
+            {
+                for (std::size_t k = 0; k < channels; ++k)
+                    row[k] = values[j * channels + k] / 255;
+
+                file_.seekp(pfm_data_ + static_cast<std::streamoff>((height_ - 1 - first - j) * channels * sizeof(float)));
+                file_.write(reinterpret_cast<char const*>(row.data()), static_cast<std::streamsize>(channels * sizeof(float)));
+            }
+            break;
+        }
+
+        case ImageFormat::png:
+        {
+            // Every scanline starts with its filter type, 0 for none.
+            bytes_.assign((channels + 1) * count, '\0');
+
+            for (int j = 0; j < count; ++j)
+            {
+                quantize_channels(values + j * channels, offsets_[(first + j) % 4].data(), channels,
+                    reinterpret_cast<unsigned char*>(bytes_.data()) + j * (channels + 1) + 1
+                );
+            }
+
+            write_png_data(bytes_, false);
+            break;
+        }
+        }
+    }
+
+    void write_footer()
+    {
+        if (format_ == ImageFormat::png)
+        {
+            write_png_data({}, true);
+            write_png_chunk("IEND", {});
+        }
+    }
+
+    /*
+    ** Continues the zlib stream split over the IDAT chunks with raw in
+    ** stored deflate blocks. The last call closes the stream with an
+    ** empty final block and the checksum.
+    */
+    void write_png_data(
+        std::string const& raw,
+        bool        const  last)
+    {
+        std::string chunk;
+
+        if (not png_started_)
+        {
+            chunk += "\x78\x01"; // Deflate, 32K window, no preset dictionary.
+            png_started_ = true;
+        }
+
+        for (std::size_t at = 0; at < raw.size(); at += 65535)
+        {
+            auto const size = static_cast<std::uint16_t>(std::min<std::size_t>(65535, raw.size() - at));
+
+            chunk += '\0'; // Not final, stored.
+            chunk += static_cast<char>(size & 0xff);
+            chunk += static_cast<char>(size >> 8);
+            chunk += static_cast<char>(~size & 0xff);
+            chunk += static_cast<char>((~size >> 8) & 0xff);
+            chunk.append(raw, at, size);
+        }
+
+        for (unsigned char const c : raw)
+        {
+            adler_a_ = (adler_a_ + c)        % 65521;
+            adler_b_ = (adler_b_ + adler_a_) % 65521;
+        }
+
+        if (last)
+        {
+            chunk += std::string("\x01\x00\x00\xff\xff", 5);
+            append_big_endian(chunk, adler_b_ << 16 | adler_a_);
+        }
+
+        write_png_chunk("IDAT", chunk);
+    }
+
+    void write_png_chunk(
+        char        const* const type,
+        std::string const&       data)
+    {
+        std::string chunk;
+        append_big_endian(chunk, static_cast<std::uint32_t>(data.size()));
+        chunk += type;
+        chunk += data;
+
+        // The CRC covers the type and the data.
+        std::uint32_t crc = 0xffffffff;
+        for (std::size_t k = 4; k < chunk.size(); ++k)
+            crc = crc_table[(crc ^ static_cast<unsigned char>(chunk[k])) & 0xff] ^ (crc >> 8);
+
+        append_big_endian(chunk, crc ^ 0xffffffff);
+
+        file_.write(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+    }
+
+    static void append_big_endian(
+        std::string&        out,
+        std::uint32_t const value)
+    {
+        for (int shift = 24; shift >= 0; shift -= 8)
+            out += static_cast<char>((value >> shift) & 0xff);
+    }
+
+    static constexpr auto crc_table = []
+    {
+        std::array<std::uint32_t, 256> table {};
+
+        for (std::uint32_t n = 0; n < 256; ++n)
+        {
+            std::uint32_t c = n;
+
+            for (int k = 0; k < 8; ++k)
+                c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+
+            table[n] = c;
+        }
+
+        return table;
+    }();
+
+    int                             width_       {};
+    int                             height_      {};
+    ImageFormat                     format_      {};
+    std::ofstream                   file_        {};
+    // Dither offsets per channel of a row, for each row modulo 4.
+    std::vector<std::vector<float>> offsets_     {};
+
+    // Used by the encoding thread only.
+    int                             next_row_    {};
+    std::string                     bytes_       {};
+    std::streampos                  pfm_data_    {};
+    bool                            png_started_ {};
+    std::uint32_t                   adler_a_     {1};
+    std::uint32_t                   adler_b_     {};
+
+    std::mutex                                      mutex_   {};
+    std::condition_variable                         ready_   {};
+    std::deque<std::pair<int, std::vector<float3>>> queue_   {};
+    bool                                            closing_ {};
+
+    std::jthread                                    thread_  {};
+};
+
+// Writes a whole image, and returns once it is in the file.
+inline void write_image(
+    std::filesystem::path const& path,
+    std::vector<float3>   const& image,
+    int                   const  width,
+    int                   const  height,
+    EncoderSettings       const  settings = {})
+{
+    ImageEncoder encoder(path, width, height, settings);
+    encoder.submit(0, height, image.data());
+}
+
+#endif // OUTPUT_IMAGE_ENCODER_H
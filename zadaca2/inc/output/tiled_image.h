@@ -0,0 +1,320 @@
+#ifndef OUTPUT_TILED_IMAGE_H
+#define OUTPUT_TILED_IMAGE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <linear_algebra.h>
+#include <output/image_encoder.h>
+
+/*
+** Images larger than memory, kept in a file of square tiles that is
+** mapped into the address space. A tile is written in one go once it
+** has been rendered, after which its pages are handed back to the
+** kernel for writing out, so only the tiles being worked on take up
+** memory, whatever the size of the image.
+**
+** The file (.tiles) is a 4096 byte header,
+**
+**      "ZTILES1\n", then the width, height and tile size as 32 bit
+**      little endian integers, then zeros,
+**
+** followed by the tiles in rows, left to right and top to bottom. Each
+** tile is tile_size * tile_size pixels of 8 bit RGB in rows, those at
+** the right and bottom edges padded to full size, so any tile is found
+** without an index.
+*/
+constexpr std::size_t tiled_image_header_bytes = 4096;
+constexpr char        tiled_image_magic[8]     = {'Z', 'T', 'I', 'L', 'E', 'S', '1', '\n'};
+
+struct TileRect
+{
+    int x0, y0, x1, y1;
+};
+
+class TiledImage
+{
+public:
+    TiledImage() = default;
+
+    TiledImage(
+        int         const fd,
+        std::size_t const size,
+        bool        const writable)
+        : fd_       {fd}
+        , size_     {size}
+        , writable_ {writable}
+    {
+        void* const mapping = ::mmap(nullptr, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+
+        if (mapping == MAP_FAILED)
+        {
+            int const error = errno;
+            ::close(fd);
+            throw std::system_error(error, std::system_category(), "mmap tiled image");
+        }
+
+        data_ = static_cast<unsigned char*>(mapping);
+
+        std::uint32_t header[3];
+        std::memcpy(header, data_ + sizeof(tiled_image_magic), sizeof(header));
+
+        width_     = static_cast<int>(header[0]);
+        height_    = static_cast<int>(header[1]);
+        tile_size_ = static_cast<int>(header[2]);
+    }
+
+    TiledImage(TiledImage&& other) noexcept
+        : fd_        {std::exchange(other.fd_, -1)}
+        , data_      {std::exchange(other.data_, nullptr)}
+        , size_      {other.size_}
+        , writable_  {other.writable_}
+        , width_     {other.width_}
+        , height_    {other.height_}
+        , tile_size_ {other.tile_size_}
+    {}
+
+    TiledImage& operator=(TiledImage&& other) noexcept
+    {
+        std::swap(fd_,        other.fd_);
+        std::swap(data_,      other.data_);
+        std::swap(size_,      other.size_);
+        std::swap(writable_,  other.writable_);
+        std::swap(width_,     other.width_);
+        std::swap(height_,    other.height_);
+        std::swap(tile_size_, other.tile_size_);
+        return *this;
+    }
+
+    ~TiledImage()
+    {
+        if (data_)
+            ::munmap(data_, size_);
+        if (fd_ >= 0)
+            ::close(fd_);
+    }
+
+    [[nodiscard]] int width()     const noexcept { return width_; }
+    [[nodiscard]] int height()    const noexcept { return height_; }
+    [[nodiscard]] int tile_size() const noexcept { return tile_size_; }
+
+    [[nodiscard]]
+    int tiles_across() const noexcept
+    {
+        return (width_ + tile_size_ - 1) / tile_size_;
+    }
+
+    [[nodiscard]]
+    int tile_count() const noexcept
+    {
+        return tiles_across() * ((height_ + tile_size_ - 1) / tile_size_);
+    }
+
+    // The pixels of tile k, clipped to the image.
+    [[nodiscard]]
+    TileRect tile_rect(int const k) const noexcept
+    {
+        int const x0 = (k % tiles_across()) * tile_size_;
+        int const y0 = (k / tiles_across()) * tile_size_;
+
+        return {x0, y0, std::min(x0 + tile_size_, width_), std::min(y0 + tile_size_, height_)};
+    }
+
+    [[nodiscard]]
+    std::size_t tile_bytes() const noexcept
+    {
+        return 3ull * tile_size_ * tile_size_;
+    }
+
+    // Tile k's pixels, tile_size of them to a row whatever its width.
+    [[nodiscard]]
+    unsigned char const* tile(int const k) const noexcept
+    {
+        return data_ + tiled_image_header_bytes + k * tile_bytes();
+    }
+
+    /*
+    ** Stores tile k from (x1 - x0) * (y1 - y0) rendered pixels in rows,
+    ** truncated to 8 bits like the other 8 bit outputs, and starts
+    ** writing it to the file. Different tiles may be stored from
+    ** different threads at once.
+    */
+    void store_tile(
+        int           const k,
+        float3 const* const pixels)
+    {
+        if (not writable_)
+            throw std::logic_error("tiled image opened for reading");
+
+        auto const rect  = tile_rect(k);
+        int  const width = rect.x1 - rect.x0;
+
+        unsigned char* const out = const_cast<unsigned char*>(tile(k));
+
+        thread_local std::vector<float> zeros;
+        zeros.resize(3 * width);
+
+        for (int j = 0; j < rect.y1 - rect.y0; ++j)
+        {
+            quantize_channels(reinterpret_cast<float const*>(pixels + j * width), zeros.data(),
+                3 * width, out + 3ull * j * tile_size_
+            );
+        }
+
+        // Writeback starts now rather than when the kernel runs short of
+        // clean pages, which keeps the dirty part of the page cache small.
+        ::sync_file_range(fd_, static_cast<off_t>(out - data_), static_cast<off_t>(tile_bytes()), SYNC_FILE_RANGE_WRITE);
+
+        release_tile(k);
+    }
+
+    /*
+    ** Drops tile k's pages from this process. The data stays in the file
+    ** (and in the page cache while the kernel has room for it), and is
+    ** read back in if the tile is touched again.
+    */
+    void release_tile(int const k) const noexcept
+    {
+        auto const page  = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        auto const begin = static_cast<std::size_t>(tile(k) - data_) / page * page;
+
+        ::madvise(data_ + begin, tiled_image_header_bytes + (k + 1) * tile_bytes() - begin, MADV_DONTNEED);
+    }
+
+private:
+    int            fd_        {-1};
+    unsigned char* data_      {};
+    std::size_t    size_      {};
+    bool           writable_  {};
+    int            width_     {};
+    int            height_    {};
+    int            tile_size_ {};
+};
+
+// A new tiled image at path, all black, replacing whatever was there.
+[[nodiscard]]
+inline TiledImage create_tiled_image(
+    std::filesystem::path const& path,
+    int                   const  width,
+    int                   const  height,
+    int                   const  tile_size = 256)
+{
+    if (width <= 0 or height <= 0 or tile_size <= 0)
+        throw std::invalid_argument("tiled image needs a positive size and tile size");
+
+    int const fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        throw std::system_error(errno, std::system_category(), "open " + path.string());
+
+    std::size_t const tiles = static_cast<std::size_t>((width + tile_size - 1) / tile_size)
+                                                      * ((height + tile_size - 1) / tile_size);
+    std::size_t const size  = tiled_image_header_bytes + tiles * 3 * tile_size * tile_size;
+
+    // Sparse: tiles take up disk space as they are written.
+    if (::ftruncate(fd, static_cast<off_t>(size)) != 0)
+    {
+        int const error = errno;
+        ::close(fd);
+        throw std::system_error(error, std::system_category(), "resize " + path.string());
+    }
+
+    char header[sizeof(tiled_image_magic) + 3 * sizeof(std::uint32_t)];
+    std::uint32_t const fields[3] = {
+        static_cast<std::uint32_t>(width),
+        static_cast<std::uint32_t>(height),
+        static_cast<std::uint32_t>(tile_size),
+    };
+
+    std::memcpy(header, tiled_image_magic, sizeof(tiled_image_magic));
+    std::memcpy(header + sizeof(tiled_image_magic), fields, sizeof(fields));
+
+    if (::pwrite(fd, header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)))
+    {
+        int const error = errno;
+        ::close(fd);
+        throw std::system_error(error, std::system_category(), "write " + path.string());
+    }
+
+    return TiledImage(fd, size, true);
+}
+
+[[nodiscard]]
+inline TiledImage open_tiled_image(std::filesystem::path const& path)
+{
+    int const fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::system_error(errno, std::system_category(), "open " + path.string());
+
+    char       magic[sizeof(tiled_image_magic)] {};
+    auto const size = ::lseek(fd, 0, SEEK_END);
+
+    if (size < static_cast<off_t>(tiled_image_header_bytes)
+        or ::pread(fd, magic, sizeof(magic), 0) != static_cast<ssize_t>(sizeof(magic))
+        or std::memcmp(magic, tiled_image_magic, sizeof(magic)) != 0)
+    {
+        ::close(fd);
+        throw std::runtime_error(path.string() + " is not a tiled image");
+    }
+
+    TiledImage image(fd, static_cast<std::size_t>(size), false);
+
+    if (image.tile_size() <= 0
+        or tiled_image_header_bytes + image.tile_count() * image.tile_bytes() > static_cast<std::size_t>(size))
+        throw std::runtime_error(path.string() + " is truncated");
+
+    return image;
+}
+
+/*
+** Writes a tiled image out as a binary PPM, a row of tiles at a time,
+** so converting a poster takes no more memory than one row of tiles.
+*/
+inline void write_tiled_image_as_ppm(
+    TiledImage            const& image,
+    std::filesystem::path const& path)
+{
+    std::ofstream file(path, std::ofstream::binary);
+    file << "P6\n" << image.width() << ' ' << image.height() << "\n255\n";
+
+    std::vector<char> row(3ull * image.width());
+
+    int const across = image.tiles_across();
+
+    for (int first = 0; first < image.tile_count(); first += across)
+    {
+        auto const rect = image.tile_rect(first);
+
+        for (int j = 0; j < rect.y1 - rect.y0; ++j)
+        {
+            for (int k = first; k < first + across; ++k)
+            {
+                auto const tile = image.tile_rect(k);
+
+                std::memcpy(row.data() + 3ull * tile.x0,
+                    image.tile(k) + 3ull * j * image.tile_size(), 3ull * (tile.x1 - tile.x0)
+                );
+            }
+
+            file.write(row.data(), static_cast<std::streamsize>(row.size()));
+        }
+
+        for (int k = first; k < first + across; ++k)
+            image.release_tile(k);
+    }
+}
+
+#endif // OUTPUT_TILED_IMAGE_H
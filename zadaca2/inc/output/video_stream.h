@@ -0,0 +1,343 @@
+#ifndef OUTPUT_VIDEO_STREAM_H
+#define OUTPUT_VIDEO_STREAM_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <immintrin.h>
+#define VIDEO_STREAM_SSE 1
+#endif
+
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <linear_algebra.h>
+#include <output/image_encoder.h>
+
+/*
+** Frames of an animation as one continuous stream, for a video encoder
+** to read as they are rendered, from a file or through a pipe:
+**
+**      main --batch=... --video=- | ffmpeg -i - out.mp4
+**
+** A path ending in .y4m (or "-" for stdout) gets YUV4MPEG2 with 4:2:0
+** full range BT.601 (JPEG) colour, which needs no options on the other
+** end. Any other path gets headerless packed 8 bit RGB, whose size and
+** rate the reader has to be told.
+**
+** Each frame is converted straight from the renderer's floats into
+** planes kept from frame to frame, and goes out with one gathering
+** write together with its header, so nothing is copied on the way.
+*/
+enum class VideoFormat
+{
+    y4m,
+    rgb,
+};
+
+/*
+** Full range BT.601, as JPEG uses it:
+**
+**      Y  =       0.299    R + 0.587    G + 0.114    B
+**      Cb = 128 - 0.168736 R - 0.331264 G + 0.5      B
+**      Cr = 128 + 0.5      R - 0.418688 G - 0.081312 B
+*/
+constexpr float luma_weights[3] = {0.299f, 0.587f, 0.114f};
+constexpr float cb_weights  [3] = {-0.168736f, -0.331264f, 0.5f};
+constexpr float cr_weights  [3] = {0.5f, -0.418688f, -0.081312f};
+
+[[nodiscard]]
+inline unsigned char to_byte(float const value)
+{
+    return static_cast<unsigned char>(std::clamp(std::nearbyint(value), 0.f, 255.f));
+}
+
+#ifdef VIDEO_STREAM_SSE
+/*
+** Four consecutive pixels, r0 g0 b0 r1 | g1 b1 r2 g2 | b2 r3 g3 b3,
+** split into one register per channel.
+*/
+inline void load_rgb_4(
+    float3 const* const pixels,
+    __m128&             r,
+    __m128&             g,
+    __m128&             b)
+{
+    auto const p = reinterpret_cast<float const*>(pixels);
+
+    __m128 const x = _mm_loadu_ps(p);
+    __m128 const y = _mm_loadu_ps(p + 4);
+    __m128 const z = _mm_loadu_ps(p + 8);
+
+    r = _mm_shuffle_ps(
+        _mm_shuffle_ps(x, x, _MM_SHUFFLE(3, 3, 0, 0)),
+        _mm_shuffle_ps(y, z, _MM_SHUFFLE(1, 1, 2, 2)),
+        _MM_SHUFFLE(2, 0, 2, 0)
+    );
+    g = _mm_shuffle_ps(
+        _mm_shuffle_ps(x, y, _MM_SHUFFLE(0, 0, 1, 1)),
+        _mm_shuffle_ps(y, z, _MM_SHUFFLE(2, 2, 3, 3)),
+        _MM_SHUFFLE(2, 0, 2, 0)
+    );
+    b = _mm_shuffle_ps(
+        _mm_shuffle_ps(x, y, _MM_SHUFFLE(1, 1, 2, 2)),
+        _mm_shuffle_ps(z, z, _MM_SHUFFLE(3, 3, 0, 0)),
+        _MM_SHUFFLE(2, 0, 2, 0)
+    );
+}
+
+[[nodiscard]]
+inline __m128 weigh(
+    float  const (&weights)[3],
+    float  const   offset,
+    __m128 const   r,
+    __m128 const   g,
+    __m128 const   b)
+{
+    return _mm_add_ps(
+        _mm_add_ps(_mm_set1_ps(offset), _mm_mul_ps(_mm_set1_ps(weights[0]), r)),
+        _mm_add_ps(_mm_mul_ps(_mm_set1_ps(weights[1]), g), _mm_mul_ps(_mm_set1_ps(weights[2]), b))
+    );
+}
+
+// Rounds four values to bytes, saturating, and stores them.
+inline void store_bytes_4(
+    __m128         const values,
+    unsigned char* const out)
+{
+    __m128i const words = _mm_packs_epi32(_mm_cvtps_epi32(values), _mm_setzero_si128());
+    int     const bytes = _mm_cvtsi128_si32(_mm_packus_epi16(words, words));
+
+    std::copy_n(reinterpret_cast<unsigned char const*>(&bytes), 4, out);
+}
+#endif
+
+/*
+** The Y plane at full resolution and the Cb and Cr planes at half
+** resolution in both directions, each chroma sample from the mean
+** colour of its 2x2 block (clamped at odd edges).
+*/
+inline void rgb_to_yuv420(
+    float3 const*  const image,
+    int            const width,
+    int            const height,
+    unsigned char* const y_plane,
+    unsigned char* const cb_plane,
+    unsigned char* const cr_plane)
+{
+    int const chroma_width = (width + 1) / 2;
+
+    for (int j = 0; j < height; ++j)
+    {
+        float3 const* row = image + j * width;
+        int           i   = 0;
+
+#ifdef VIDEO_STREAM_SSE
+        for (; i + 4 <= width; i += 4)
+        {
+            __m128 r, g, b;
+            load_rgb_4(row + i, r, g, b);
+
+            store_bytes_4(weigh(luma_weights, 0, r, g, b), y_plane + j * width + i);
+        }
+#endif
+
+        for (; i < width; ++i)
+        {
+            float3 const c = row[i];
+            y_plane[j * width + i] = to_byte(
+                luma_weights[0] * c.x + luma_weights[1] * c.y + luma_weights[2] * c.z
+            );
+        }
+    }
+
+    for (int j = 0; j < (height + 1) / 2; ++j)
+    {
+        float3 const* top    = image + (2 * j) * width;
+        float3 const* bottom = image + std::min(2 * j + 1, height - 1) * width;
+
+        unsigned char* const cb = cb_plane + j * chroma_width;
+        unsigned char* const cr = cr_plane + j * chroma_width;
+
+        int i = 0;
+
+#ifdef VIDEO_STREAM_SSE
+        // Eight pixels across, two rows down, make four chroma samples.
+        for (; 2 * i + 8 <= width; i += 4)
+        {
+            __m128 r0, g0, b0, r1, g1, b1, r2, g2, b2, r3, g3, b3;
+            load_rgb_4(top    + 2 * i    , r0, g0, b0);
+            load_rgb_4(top    + 2 * i + 4, r1, g1, b1);
+            load_rgb_4(bottom + 2 * i    , r2, g2, b2);
+            load_rgb_4(bottom + 2 * i + 4, r3, g3, b3);
+
+            // Lanes 0..3 of lo and hi are pixels 0..3 and 4..7; pairs of
+            // neighbours are the even and the odd lanes.
+            auto const block_mean = [](__m128 const lo, __m128 const hi)
+            {
+                return _mm_add_ps(
+                    _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)),
+                    _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1))
+                );
+            };
+
+            __m128 const quarter = _mm_set1_ps(0.25f);
+
+            __m128 const r = _mm_mul_ps(quarter, _mm_add_ps(block_mean(r0, r1), block_mean(r2, r3)));
+            __m128 const g = _mm_mul_ps(quarter, _mm_add_ps(block_mean(g0, g1), block_mean(g2, g3)));
+            __m128 const b = _mm_mul_ps(quarter, _mm_add_ps(block_mean(b0, b1), block_mean(b2, b3)));
+
+            store_bytes_4(weigh(cb_weights, 128, r, g, b), cb + i);
+            store_bytes_4(weigh(cr_weights, 128, r, g, b), cr + i);
+        }
+#endif
+
+        for (; i < chroma_width; ++i)
+        {
+            int const left  = 2 * i;
+            int const right = std::min(2 * i + 1, width - 1);
+
+            float3 const c = 0.25f * (top[left] + top[right] + bottom[left] + bottom[right]);
+
+            cb[i] = to_byte(128 + cb_weights[0] * c.x + cb_weights[1] * c.y + cb_weights[2] * c.z);
+            cr[i] = to_byte(128 + cr_weights[0] * c.x + cr_weights[1] * c.y + cr_weights[2] * c.z);
+        }
+    }
+}
+
+class VideoStream
+{
+public:
+    VideoStream(
+        std::filesystem::path const& path,
+        int                   const  width,
+        int                   const  height,
+        int                   const  frame_rate = 30)
+        : width_  {width}
+        , height_ {height}
+        , format_ {path == "-" or path.extension() == ".y4m" ? VideoFormat::y4m : VideoFormat::rgb}
+    {
+        if (path == "-")
+        {
+            fd_ = STDOUT_FILENO;
+        }
+        else
+        {
+            fd_    = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            owned_ = true;
+        }
+
+        if (fd_ < 0)
+            throw std::system_error(errno, std::system_category(), "open " + path.string());
+
+        if (format_ == VideoFormat::y4m)
+        {
+            int const chroma = ((width + 1) / 2) * ((height + 1) / 2);
+
+            planes_.resize(width * height + 2 * chroma);
+
+            write(
+                "YUV4MPEG2 W" + std::to_string(width) + " H" + std::to_string(height)
+                + " F" + std::to_string(frame_rate) + ":1 Ip A1:1 C420jpeg XCOLORRANGE=FULL\n"
+            );
+        }
+        else
+        {
+            planes_.resize(3 * width * height);
+            zeros_.resize(3 * width);
+        }
+    }
+
+    VideoStream(VideoStream const&)            = delete;
+    VideoStream& operator=(VideoStream const&) = delete;
+
+    ~VideoStream()
+    {
+        if (owned_)
+            ::close(fd_);
+    }
+
+    // Appends a frame of width * height pixels.
+    void write_frame(float3 const* const image)
+    {
+        if (format_ == VideoFormat::rgb)
+        {
+            for (int j = 0; j < height_; ++j)
+            {
+                quantize_channels(reinterpret_cast<float const*>(image + j * width_), zeros_.data(),
+                    3 * width_, planes_.data() + 3 * j * width_
+                );
+            }
+
+            return write("", planes_);
+        }
+
+        int const luma = width_ * height_;
+
+        rgb_to_yuv420(image, width_, height_,
+            planes_.data(), planes_.data() + luma, planes_.data() + luma + (planes_.size() - luma) / 2
+        );
+
+        write("FRAME\n", planes_);
+    }
+
+private:
+    // The header and the data in one gathering write, however many
+    // calls it takes to get all of it out.
+    void write(
+        std::string                const& header,
+        std::vector<unsigned char> const& data = {})
+    {
+        iovec parts[2] = {
+            {const_cast<char*>(header.data()), header.size()},
+            {const_cast<unsigned char*>(data.data()), data.size()},
+        };
+
+        iovec* part  = parts;
+        int    count = 2;
+
+        while (count > 0)
+        {
+            auto written = ::writev(fd_, part, count);
+
+            if (written < 0 and errno == EINTR)
+                continue;
+            if (written < 0)
+                throw std::system_error(errno, std::system_category(), "write video frame");
+
+            while (count > 0 and static_cast<std::size_t>(written) >= part->iov_len)
+            {
+                written -= static_cast<ssize_t>(part->iov_len);
+                ++part;
+                --count;
+            }
+
+            if (count > 0)
+            {
+                part->iov_base = static_cast<char*>(part->iov_base) + written;
+                part->iov_len -= static_cast<std::size_t>(written);
+            }
+        }
+    }
+
+    int         width_  {};
+    int         height_ {};
+    VideoFormat format_ {};
+    int         fd_     {-1};
+    bool        owned_  {};
+
+    // Y, Cb and Cr one after the other, or packed RGB.
+    std::vector<unsigned char> planes_ {};
+    // No dither offsets, for quantizing RGB rows.
+    std::vector<float>         zeros_  {};
+};
+
+#endif // OUTPUT_VIDEO_STREAM_H
@@ -2,6 +2,7 @@
 #define RAYS_SHADING_H
 
 #include <limits>
+#include <vector>
 #include <algorithm>
 
 #include <linear_algebra.h>
@@ -32,7 +33,8 @@ constexpr float blinn_phong_model(
     PointLight                  const  light,
     float3                      const  light_direction,
     Ray                         const  ray,
-    Object::RayIntersectionData const& data)
+    Object::RayIntersectionData const& data,
+    float                       const  exponent)
 {
     float3 const view_direction
         = (ray.source - data.intersection_point).normalize();
@@ -41,60 +43,148 @@ constexpr float blinn_phong_model(
 
     float const reflection_intensity
         = std::max(0.f, half_vector.dot(data.intersection_normal));
-    float const exponent
-        = data.intersected_object->material.specular_exponent;
 
     return light.intensity * std::pow(reflection_intensity, exponent);
 }
 
+struct LightContribution
+{
+    float diffuse  {};
+    float specular {};
+};
+
+struct ShadowRay
+{
+    Ray   ray            {};
+    float light_distance {};
+};
+
 [[nodiscard]]
-float3 shade(
-    Ray                         const ray,
-    Object::RayIntersectionData const data,
-    std::vector<Object const*> const& objects,
-    std::vector<PointLight   > const& lights)
+constexpr ShadowRay make_shadow_ray(
+    float3     const p,
+    float3     const n,
+    PointLight const light)
 {
-    float diffuse_intensity  = 0;
-    float specular_intensity = 0;
+    auto const light_direction = (light.position - p).normalize();
+    auto const light_distance  = (light.position - p).length();
 
-    for (auto const light : lights)
-    {
-        float3 const p = data.intersection_point;
-        float3 const n = data.intersection_normal;
-
-        auto const light_direction = (light.position - p).normalize();
-        auto const light_distance  = (light.position - p).length();
-
-        float3 shadow_origin;
-        if (light_direction.dot(n) < 0)
-            shadow_origin = p - 0.001 * n;
-        else
-            shadow_origin = p + 0.001 * n;
-
-        {
-            auto const shadow_data = get_nearest_ray_intersection_data(
-                Ray{shadow_origin, light_direction},
-                objects
-            );
-            // Vector from the shadow origin to the blocking object.
-            float3 const u = shadow_data.intersection_point - shadow_origin;
-
-            if (shadow_data.intersected_object and u.length() < light_distance)
-                continue;
-        }
-
-        diffuse_intensity  += lambert_model(light, light_direction, n);
-        specular_intensity += blinn_phong_model(light, light_direction, ray, data);
-    }
+    float3 shadow_origin;
+    if (light_direction.dot(n) < 0)
+        shadow_origin = p - 0.001 * n;
+    else
+        shadow_origin = p + 0.001 * n;
+
+    return {{shadow_origin, light_direction}, light_distance};
+}
+
+template <typename Scene> [[nodiscard]]
+bool is_in_shadow(
+    float3     const  p,
+    float3     const  n,
+    PointLight const  light,
+    Scene      const& objects)
+{
+    auto const [shadow_ray, light_distance] = make_shadow_ray(p, n, light);
+
+    auto const shadow_data
+        = get_nearest_ray_intersection_data(shadow_ray, objects);
+    // Vector from the shadow origin to the blocking object.
+    float3 const u = shadow_data.intersection_point - shadow_ray.source;
+
+    return shadow_data.intersected_object and u.length() < light_distance;
+}
+
+// Any hit closer than the light will do, so callers can stop at the first one.
+[[nodiscard]]
+inline bool blocks_shadow_ray(
+    Object const* const object,
+    ShadowRay     const shadow_ray)
+{
+    auto const data = object->get_ray_intersection_data(shadow_ray.ray);
+    auto const d    = data.intersection_distance;
+
+    if (d <= 0 or d >= 20000)
+        return false;
+
+    float3 const u = data.intersection_point - shadow_ray.ray.source;
+
+    return u.length() < shadow_ray.light_distance;
+}
+
+// Lambert and Blinn-Phong terms of an unoccluded light.
+[[nodiscard]]
+constexpr LightContribution light_terms(
+    Ray                         const  ray,
+    Object::RayIntersectionData const& data,
+    Material                    const& material,
+    PointLight                  const  light)
+{
+    float3 const p = data.intersection_point;
+    float3 const n = data.intersection_normal;
 
-    Material const material = data.intersected_object->material;
+    auto const light_direction = (light.position - p).normalize();
+
+    return {
+        .diffuse  = lambert_model(light, light_direction, n),
+        .specular = blinn_phong_model(
+            light, light_direction, ray, data, material.specular_exponent
+        ),
+    };
+}
+
+template <typename Scene> [[nodiscard]]
+LightContribution illuminate(
+    Ray                         const  ray,
+    Object::RayIntersectionData const& data,
+    Scene                       const& objects,
+    Material                    const& material,
+    PointLight                  const  light)
+{
+    float3 const p = data.intersection_point;
+    float3 const n = data.intersection_normal;
+
+    if (is_in_shadow(p, n, light, objects))
+        return {};
+
+    return light_terms(ray, data, material, light);
+}
+
+[[nodiscard]]
+constexpr float3 combine_light(
+    Material          const& material,
+    LightContribution const  total)
+{
     float const d = material.diffuse_coefficient;
     float const s = material.specular_coefficient;
 
-    float3 const diffuse_part  = diffuse_intensity  * d * material.diffuse_color;
-    float3 const specular_part = specular_intensity * s * float3{255, 255, 255};
+    float3 const diffuse_part  = total.diffuse  * d * material.diffuse_color;
+    float3 const specular_part = total.specular * s * float3{255, 255, 255};
 
     return color_clamp(diffuse_part + specular_part);
 }
 
+template <typename Scene> [[nodiscard]]
+float3 shade(
+    Ray                         const  ray,
+    Object::RayIntersectionData const  data,
+    Scene                       const& objects,
+    MaterialTable               const& materials,
+    std::vector<PointLight>     const& lights)
+{
+    Material const material = materials[data.intersected_object->material];
+
+    LightContribution total {};
+
+    for (auto const light : lights)
+    {
+        auto const contribution
+            = illuminate(ray, data, objects, material, light);
+
+        total.diffuse  += contribution.diffuse;
+        total.specular += contribution.specular;
+    }
+
+    return combine_light(material, total);
+}
+
 #endif // RAYS_SHADING_H
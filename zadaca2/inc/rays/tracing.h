@@ -6,12 +6,56 @@
 #include <rays/ray.h>
 #include <rays/shading.h>
 
-template <int max_depth> [[nodiscard]]
+template <int max_depth, typename Scene, typename Lights> [[nodiscard]]
 constexpr float3 trace(
-    Ray                        const  ray,
-    std::vector<Object const*> const& objects,
-    std::vector<PointLight   > const& lights,
-    int                        const  depth = 0)
+    Ray           const  ray,
+    Scene         const& objects,
+    MaterialTable const& materials,
+    Lights        const& lights,
+    int           const  depth = 0);
+
+// Shading and reflections for a ray whose nearest hit is already known.
+template <int max_depth, typename Scene, typename Lights> [[nodiscard]]
+constexpr float3 trace_hit(
+    Ray                         const  ray,
+    Object::RayIntersectionData const& data,
+    Scene                       const& objects,
+    MaterialTable               const& materials,
+    Lights                      const& lights,
+    int                         const  depth = 0)
+{
+    auto const p = data.intersection_point;
+    auto const n = data.intersection_normal;
+
+    float3 const color = shade(ray, data, objects, materials, lights);
+    float  const reflectivity
+        = materials[data.intersected_object->material].reflectivity;
+
+    // Matte surfaces don't spawn a secondary ray at all.
+    if (reflectivity <= 0)
+        return color;
+
+    Ray const reflected =
+    {
+        .source    = p + 0.1 * n,
+        .direction = reflect(ray.direction, n)
+    };
+
+    return color_clamp(
+        color
+        + reflectivity * trace<max_depth>(
+            reflected, objects, materials, lights, depth + 1
+        )
+    );
+}
+
+template <int max_depth, typename Scene, typename Lights> [[nodiscard]]
+constexpr float3 trace(
+    Ray           const  ray,
+    Scene         const& objects,
+    MaterialTable const& materials,
+    Lights        const& lights,
+    int           const  depth)
 {
     if (depth >= max_depth)
         return {0, 0, 0};
@@ -20,19 +64,7 @@ constexpr float3 trace(
 
     if (data.intersected_object)
     {
-        auto const p = data.intersection_point;
-        auto const n = data.intersection_normal;
-
-        Ray const reflected =
-        {
-            .source    = p + 0.1 * n,
-            .direction = reflect(ray.direction, n)
-        };
-
-        return color_clamp(
-            shade(ray, data, objects, lights)
-            + 0.4 * trace<max_depth>(reflected, objects, lights, depth + 1)
-        );
+        return trace_hit<max_depth>(ray, data, objects, materials, lights, depth);
     }
     else
     {
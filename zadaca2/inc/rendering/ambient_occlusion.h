@@ -0,0 +1,299 @@
+#ifndef RENDERING_AMBIENT_OCCLUSION_H
+#define RENDERING_AMBIENT_OCCLUSION_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <numbers>
+#include <vector>
+
+#include <linear_algebra.h>
+#include <objects/object.h>
+#include <rays/ray.h>
+#include <rays/shading.h>
+#include <rendering/gbuffer.h>
+#include <sampling/sampler.h>
+#include <threading/parallel_for.h>
+
+/*
+** Ambient occlusion of the primary hits, as an ambient term added on
+** top of the direct lighting:
+**
+**      colour += ambient * ao * diffuse_coefficient * albedo,
+**
+** where ao is the fraction of cosine weighted directions over the
+** hemisphere around the normal that are open for at least `radius`.
+** Occlusion rays only need to know whether anything is that close, so
+** they are any-hit tests against the few objects within `radius`.
+*/
+struct AmbientOcclusionSettings
+{
+    float radius          = 40;
+    int   samples         = 16;
+    // Evaluate every other pixel in both directions, and fill in the
+    // rest with a bilateral upsample guided by the G-buffer.
+    bool  half_resolution = false;
+    float ambient         = 0.2f;
+};
+
+/*
+** Cosine weighted directions in the frame where the normal is +z, one
+** plane per component. Neighbouring pixels use different tables, so the
+** error of each turns into fine noise rather than banding.
+*/
+struct HemisphereSamples
+{
+    std::vector<float> x {};
+    std::vector<float> y {};
+    std::vector<float> z {};
+};
+
+struct HemisphereTables
+{
+    // Pixels pick a table by their position in a 4x4 tile.
+    static constexpr int count = 16;
+
+    int                            samples {-1};
+    std::vector<HemisphereSamples> tables  {};
+};
+
+// The calling thread's tables for the given sample count, built on first use.
+[[nodiscard]]
+inline HemisphereTables const& hemisphere_tables(int const samples)
+{
+    thread_local HemisphereTables tables;
+
+    if (tables.samples == samples)
+        return tables;
+
+    tables.samples = samples;
+    tables.tables.assign(HemisphereTables::count, {});
+
+    for (int t = 0; t < HemisphereTables::count; ++t)
+    {
+        auto& table = tables.tables[t];
+
+        for (int s = 0; s < samples; ++s)
+        {
+            auto const u = scrambled_sobol_2d(
+                static_cast<std::uint32_t>(s), mix_bits(static_cast<std::uint64_t>(t))
+            );
+
+            // Uniform on the unit disk, lifted onto the hemisphere.
+            float const r   = std::sqrt(u.x);
+            float const phi = 2 * std::numbers::pi_v<float> * u.y;
+
+            table.x.push_back(r * std::cos(phi));
+            table.y.push_back(r * std::sin(phi));
+            table.z.push_back(std::sqrt(std::max(0.f, 1 - u.x)));
+        }
+    }
+
+    return tables;
+}
+
+/*
+** Open fraction of the hemisphere above a G-buffer sample. Rays start
+** just off the surface, so the sample's own primitive is skipped only
+** when it is a closed convex solid, which nothing leaving it outwards
+** can hit again; an open cylinder still occludes its own inside.
+*/
+[[nodiscard]]
+inline float ambient_occlusion_at(
+    GBufferSample            const& sample,
+    GBuffer                  const& gbuffer,
+    std::vector<BoundingBox> const& bounds,
+    HemisphereSamples        const& table,
+    float                    const  radius)
+{
+    float3 const p = sample.position;
+    float3 const n = sample.normal;
+
+    BoundingBox const reach
+    {
+        .min = p - float3{radius, radius, radius},
+        .max = p + float3{radius, radius, radius},
+    };
+
+    bool const skip_own = gbuffer.objects[sample.object]->closed_convex();
+
+    thread_local std::vector<Object const*> candidates;
+    candidates.clear();
+
+    for (std::uint32_t k = 0; k < bounds.size(); ++k)
+    {
+        if ((k != sample.object or not skip_own) and bounds[k].overlaps(reach))
+            candidates.push_back(gbuffer.objects[k]);
+    }
+
+    if (candidates.empty())
+        return 1;
+
+    // Tangent frame around n (Duff et al. 2017).
+    float  const sign = std::copysign(1.f, n.z);
+    float  const a    = -1 / (sign + n.z);
+    float  const b    = n.x * n.y * a;
+    float3 const t    = {1 + sign * n.x * n.x * a, sign * b, -sign * n.x};
+    float3 const s    = {b, sign + n.y * n.y * a, -n.y};
+
+    float3 const origin = p + 0.001 * n;
+
+    int open = 0;
+
+    for (std::size_t i = 0; i < table.x.size(); ++i)
+    {
+        float3 const direction = table.x[i] * t + table.y[i] * s + table.z[i] * n;
+
+        ShadowRay const ray {{origin, direction}, radius};
+
+        bool blocked = false;
+
+        for (auto const* object : candidates)
+        {
+            if (blocks_shadow_ray(object, ray))
+            {
+                blocked = true;
+                break;
+            }
+        }
+
+        open += not blocked;
+    }
+
+    return static_cast<float>(open) / static_cast<float>(table.x.size());
+}
+
+/*
+** Full resolution occlusion from the half resolution one, where low
+** resolution pixel (a, b) was evaluated at full resolution (2a, 2b).
+** Each pixel blends its up to four nearest evaluated neighbours with
+** bilinear weights, scaled down for neighbours at another depth or
+** facing another way so occlusion doesn't bleed across silhouettes.
+*/
+[[nodiscard]]
+inline float upsample_ambient_occlusion(
+    std::vector<float> const& low,
+    int                const  low_width,
+    int                const  low_height,
+    GBuffer            const& gbuffer,
+    int                const  i,
+    int                const  j)
+{
+    auto const& center = gbuffer.samples[j * gbuffer.width + i];
+
+    float sum    = 0;
+    float weight = 0;
+
+    int const a0 = i / 2;
+    int const b0 = j / 2;
+
+    for (int b = b0; b <= std::min(b0 + 1, low_height - 1); ++b)
+    {
+        for (int a = a0; a <= std::min(a0 + 1, low_width - 1); ++a)
+        {
+            auto const& neighbour = gbuffer.samples[2 * b * gbuffer.width + 2 * a];
+
+            if (neighbour.object == GBufferSample::no_object)
+                continue;
+
+            float const bilinear = (1 - std::abs(i - 2 * a) / 2.f)
+                                 * (1 - std::abs(j - 2 * b) / 2.f);
+            float const depth    = 1 / (1 + 20 * std::abs(neighbour.distance - center.distance) / center.distance);
+            float const facing   = std::pow(std::max(0.f, neighbour.normal.dot(center.normal)), 8.f);
+
+            float const w = bilinear * depth * facing;
+
+            sum    += w * low[b * low_width + a];
+            weight += w;
+        }
+    }
+
+    // No similar neighbour, so fall back to the closest one.
+    if (weight < 1e-4f)
+        return low[std::min(b0, low_height - 1) * low_width + std::min(a0, low_width - 1)];
+
+    return sum / weight;
+}
+
+// Per pixel open fraction, 1 where there is no surface.
+[[nodiscard]]
+inline std::vector<float> render_ambient_occlusion(
+    GBuffer                  const& gbuffer,
+    AmbientOcclusionSettings const  settings = {})
+{
+    int const w = gbuffer.width;
+    int const h = gbuffer.height;
+
+    std::vector<BoundingBox> bounds;
+    for (auto const* object : gbuffer.objects)
+        bounds.push_back(object->bounding_box());
+
+    int const step       = settings.half_resolution ? 2 : 1;
+    int const low_width  = (w + step - 1) / step;
+    int const low_height = (h + step - 1) / step;
+
+    std::vector<float> low(low_width * low_height, 1);
+
+    parallel_for(low_height, [&](std::size_t const b)
+    {
+        auto const& tables = hemisphere_tables(settings.samples);
+
+        for (int a = 0; a < low_width; ++a)
+        {
+            auto const& sample = gbuffer.samples[b * step * w + a * step];
+
+            if (sample.object == GBufferSample::no_object)
+                continue;
+
+            auto const& table = tables.tables[(b & 3) * 4 + (a & 3)];
+
+            low[b * low_width + a]
+                = ambient_occlusion_at(sample, gbuffer, bounds, table, settings.radius);
+        }
+    });
+
+    if (not settings.half_resolution)
+        return low;
+
+    std::vector<float> ao(w * h, 1);
+
+    parallel_for(h, [&](std::size_t const j)
+    {
+        for (int i = 0; i < w; ++i)
+        {
+            if (gbuffer.samples[j * w + i].object == GBufferSample::no_object)
+                continue;
+
+            ao[j * w + i] = upsample_ambient_occlusion(
+                low, low_width, low_height, gbuffer, i, static_cast<int>(j)
+            );
+        }
+    });
+
+    return ao;
+}
+
+inline void apply_ambient_occlusion(
+    std::vector<float3>&            image,
+    std::vector<float>       const& ao,
+    GBuffer                  const& gbuffer,
+    MaterialTable            const& materials,
+    AmbientOcclusionSettings const  settings = {})
+{
+    for (std::size_t i = 0; i < image.size(); ++i)
+    {
+        auto const& sample = gbuffer.samples[i];
+
+        if (sample.object == GBufferSample::no_object)
+            continue;
+
+        auto const& material = materials[sample.material];
+
+        image[i] = color_clamp(image[i]
+            + settings.ambient * ao[i] * material.diffuse_coefficient * material.diffuse_color
+        );
+    }
+}
+
+#endif // RENDERING_AMBIENT_OCCLUSION_H
@@ -0,0 +1,319 @@
+#ifndef RENDERING_AUTO_TUNE_H
+#define RENDERING_AUTO_TUNE_H
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <latch>
+#include <memory>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+#include <linear_algebra.h>
+#include <objects/object.h>
+#include <rendering/camera.h>
+#include <rendering/render.h>
+#include <scenes/scene_file.h>
+#include <threading/thread_pool.h>
+#include <threading/work_stealing_pool.h>
+
+/*
+** Picking tile size and thread count for the machine and the scene,
+** instead of guessing.
+**
+** Calibration renders the scene at a fraction of the frame's resolution
+** with every combination of the candidates below, each twice, keeps the
+** fastest time of each, and picks the fastest combination. Tile sizes
+** are scaled down with the frame, so it is cut into as many tiles as the
+** full frame would be and the threads balance the same load;
+** measurements are recorded with the full resolution sizes. It runs on
+** the kind of pool the render will, as that decides how the tiles are
+** shared out.
+**
+** The choice is stored per host, scene class and pool, so later runs on
+** the same machine with similar scenes reuse it, and every calibration,
+** with all of its measurements, is appended to a log next to the stored
+** choices.
+**
+** The tracer follows one ray at a time, so there is no packet width to
+** tune.
+*/
+struct RenderTuning
+{
+    int      tile_size = 64;
+    unsigned threads   = std::max(1u, std::thread::hardware_concurrency());
+};
+
+struct TuningMeasurement
+{
+    RenderTuning tuning {};
+    double       ms     {};
+};
+
+struct TuningCandidates
+{
+    std::vector<int>      tile_sizes = {16, 32, 64, 128};
+    // Powers of two up to the hardware threads, and those, if empty.
+    std::vector<unsigned> threads    = {};
+    // Of the frame's width and height, and of the tile sizes with them;
+    // small enough that the smallest tile still has a few pixels a side.
+    int                   downsample = 4;
+};
+
+// The machine, as far as tuning goes: its name and its thread count.
+[[nodiscard]]
+inline std::string tuning_host()
+{
+    char name[256] {};
+    ::gethostname(name, sizeof(name) - 1);
+
+    return std::string(name) + '/' + std::to_string(std::thread::hardware_concurrency());
+}
+
+/*
+** Scenes that should tune alike: the number of primitives and of lights,
+** rounded up to powers of two, and whether anything reflects, which is
+** what decides how much work a pixel is and how uneven it gets.
+*/
+[[nodiscard]]
+inline std::string scene_class(SceneFile const& scene)
+{
+    bool const reflective = std::any_of(scene.objects.begin(), scene.objects.end(), [&](Object const* object)
+    {
+        return scene.materials[object->material].reflectivity > 0;
+    });
+
+    return "objects" + std::to_string(std::bit_ceil(scene.objects.size()))
+         + "-lights" + std::to_string(std::bit_ceil(scene.lights.size()))
+         + (reflective ? "-reflective" : "-matte");
+}
+
+// $XDG_CACHE_HOME/zadaca2/tuning.txt, or under ~/.cache without it.
+[[nodiscard]]
+inline std::filesystem::path default_tuning_file()
+{
+    if (char const* cache = std::getenv("XDG_CACHE_HOME"); cache and *cache)
+        return std::filesystem::path(cache) / "zadaca2" / "tuning.txt";
+    if (char const* home = std::getenv("HOME"); home and *home)
+        return std::filesystem::path(home) / ".cache" / "zadaca2" / "tuning.txt";
+
+    return "zadaca2-tuning.txt";
+}
+
+/*
+** The stored choices, one per line:
+**
+**      <host> <scene class>-<pool> <tile size> <threads>
+*/
+[[nodiscard]]
+inline std::optional<RenderTuning> load_tuning(
+    std::filesystem::path const& path,
+    std::string           const& host,
+    std::string           const& scene)
+{
+    std::ifstream file(path);
+    std::string   line;
+
+    while (std::getline(file, line))
+    {
+        std::istringstream fields(line);
+        std::string        line_host, line_scene;
+        RenderTuning       tuning;
+
+        fields >> line_host >> line_scene >> tuning.tile_size >> tuning.threads;
+
+        if (not fields.fail() and line_host == host and line_scene == scene)
+            return tuning;
+    }
+
+    return std::nullopt;
+}
+
+// Replaces the choice for host and scene class, or adds it.
+inline void store_tuning(
+    std::filesystem::path const& path,
+    std::string           const& host,
+    std::string           const& scene,
+    RenderTuning          const& tuning)
+{
+    std::filesystem::create_directories(path.parent_path().empty() ? "." : path.parent_path());
+
+    std::string kept;
+
+    {
+        std::ifstream file(path);
+        std::string   line;
+
+        while (std::getline(file, line))
+        {
+            if (not line.starts_with(host + ' ' + scene + ' '))
+                kept += line + '\n';
+        }
+    }
+
+    // Written aside and renamed over, so a reader never sees half of it.
+    auto const temporary = path.string() + '.' + std::to_string(std::random_device{}()) + ".tmp";
+
+    {
+        std::ofstream file(temporary);
+        file << kept << host << ' ' << scene << ' '
+             << tuning.tile_size << ' ' << tuning.threads << '\n';
+    }
+
+    std::filesystem::rename(temporary, path);
+}
+
+// Appends a calibration, fastest first, to the audit log.
+inline void log_tuning(
+    std::filesystem::path          const& path,
+    std::string                    const& host,
+    std::string                    const& scene,
+    std::vector<TuningMeasurement> const& measurements)
+{
+    std::ofstream log(path, std::ofstream::app);
+
+    std::time_t const now = std::time(nullptr);
+    log << "calibration " << std::put_time(std::gmtime(&now), "%Y-%m-%dT%H:%M:%SZ")
+        << ' ' << host << ' ' << scene << '\n';
+
+    for (std::size_t k = 0; k < measurements.size(); ++k)
+    {
+        auto const& [tuning, ms] = measurements[k];
+
+        log << (k == 0 ? "  chosen " : "         ")
+            << "tile " << tuning.tile_size << " threads " << tuning.threads
+            << ": " << ms << " ms\n";
+    }
+}
+
+// Queues tile k of tiles as the frame modes do: in any order on the
+// shared queue pool, and in a band per node on the work stealing one.
+inline void submit_tile(
+    ThreadPool&                  pool,
+    int                   const  /* k */,
+    int                   const  /* tiles */,
+    std::function<void()>        task)
+{
+    pool.submit(0, std::move(task));
+}
+
+inline void submit_tile(
+    WorkStealingPool&            pool,
+    int                   const  k,
+    int                   const  tiles,
+    std::function<void()>        task)
+{
+    pool.submit(std::move(task), static_cast<int>(static_cast<long long>(k) * pool.node_count() / tiles));
+}
+
+/*
+** Times every combination of candidates rendering the scene from camera
+** at width / downsample by height / downsample, with tile sizes divided
+** by downsample too, on pools of each thread count made
+** by make_pool(threads), and returns them fastest first. On a work
+** stealing pool every node traces the one copy of the scene given.
+*/
+template <typename MakePool, typename Scene, typename Lights> [[nodiscard]]
+std::vector<TuningMeasurement> calibrate_rendering(
+    MakePool         const& make_pool,
+    Camera           const& camera,
+    int              const  width,
+    int              const  height,
+    Scene            const& objects,
+    MaterialTable    const& materials,
+    Lights           const& lights,
+    TuningCandidates        candidates = {})
+{
+    using clock = std::chrono::steady_clock;
+
+    if (candidates.threads.empty())
+    {
+        unsigned const hardware = std::max(1u, std::thread::hardware_concurrency());
+
+        for (unsigned t = 1; t < hardware; t *= 2)
+            candidates.threads.push_back(t);
+
+        candidates.threads.push_back(hardware);
+    }
+
+    int const downsample = std::max(1, candidates.downsample);
+
+    int const w = std::max(1, width  / downsample);
+    int const h = std::max(1, height / downsample);
+
+    auto const rays = make_camera_rays(camera, w, h);
+
+    std::vector<TuningMeasurement> measurements;
+
+    for (unsigned const threads : candidates.threads)
+    {
+        auto const pool = make_pool(threads);
+
+        for (int const tile_size : candidates.tile_sizes)
+        {
+            int const tile = std::max(1, tile_size / downsample);
+
+            int const across = (w + tile - 1) / tile;
+            int const tiles  = across * ((h + tile - 1) / tile);
+
+            double best = 0;
+
+            for (int run = 0; run < 2; ++run)
+            {
+                auto const start = clock::now();
+
+                std::latch rendered(tiles);
+
+                for (int k = 0; k < tiles; ++k)
+                {
+                    submit_tile(*pool, k, tiles, [&, k]
+                    {
+                        thread_local std::vector<float3> pixels;
+
+                        int const x0 = (k % across) * tile;
+                        int const y0 = (k / across) * tile;
+                        int const x1 = std::min(x0 + tile, w);
+                        int const y1 = std::min(y0 + tile, h);
+
+                        pixels.resize((x1 - x0) * (y1 - y0));
+                        render_tile(rays, x0, y0, x1, y1, objects, materials, lights, pixels.data());
+
+                        rendered.count_down();
+                    });
+                }
+
+                rendered.wait();
+
+                double const ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+                best = run == 0 ? ms : std::min(best, ms);
+            }
+
+            measurements.push_back({
+                .tuning = {.tile_size = tile_size, .threads = threads},
+                .ms     = best,
+            });
+        }
+    }
+
+    std::stable_sort(measurements.begin(), measurements.end(), [](auto const& a, auto const& b)
+    {
+        return a.ms < b.ms;
+    });
+
+    return measurements;
+}
+
+#endif // RENDERING_AUTO_TUNE_H
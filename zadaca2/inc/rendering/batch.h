@@ -0,0 +1,265 @@
+#ifndef RENDERING_BATCH_H
+#define RENDERING_BATCH_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <future>
+#include <istream>
+#include <latch>
+#include <numbers>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <linear_algebra.h>
+#include <objects/object.h>
+#include <output/image_encoder.h>
+#include <rendering/camera.h>
+#include <rendering/render.h>
+#include <threading/thread_pool.h>
+
+/*
+** Many frames of one static scene along a camera path, in one process.
+**
+** Everything that doesn't depend on the camera, the scene, its light
+** structures and the worker threads, is set up once by the caller and
+** shared by every frame. Frames are rendered one after another, each
+** spread over the pool in bands of rows, and a frame is written out
+** in the background while the next one is set up and rendered.
+*/
+
+/*
+** Keyframes of a camera flight, one per line:
+**
+**      keyframe <position> <target> <horizontal fov in degrees>
+**
+** Frames in between move the camera and its target along straight
+** lines between consecutive keyframes, at constant speed in the
+** keyframe index. Blank lines and everything after a '#' are ignored.
+**
+** The camera is kept upright, so it can never look straight up or down:
+** a keyframe whose target is right above or below it, or is where it
+** is, is an error, and so are two keyframes between which the view
+** would swing through the vertical.
+*/
+struct CameraKeyframe
+{
+    float3 position       {};
+    float3 target         {};
+    float  horizontal_fov {};
+};
+
+using CameraPath = std::vector<CameraKeyframe>;
+
+[[nodiscard]]
+inline CameraPath parse_camera_path(std::istream& input)
+{
+    CameraPath path;
+
+    std::string line;
+
+    for (int number = 1; std::getline(input, line); ++number)
+    {
+        line = line.substr(0, line.find('#'));
+
+        std::istringstream statement(line);
+        std::string        kind;
+
+        if (not (statement >> kind))
+            continue;
+
+        CameraKeyframe key;
+        statement >> key.position.x >> key.position.y >> key.position.z
+                  >> key.target.x   >> key.target.y   >> key.target.z
+                  >> key.horizontal_fov;
+
+        if (kind != "keyframe" or statement.fail())
+            throw std::runtime_error("line " + std::to_string(number) + ": expected 'keyframe' and 7 numbers");
+
+        auto const fail = [&](std::string const& message)
+        {
+            return std::runtime_error("line " + std::to_string(number) + ": " + message);
+        };
+
+        if (not (key.horizontal_fov > 0 and key.horizontal_fov < 180))
+            throw fail("field of view has to be between 0 and 180 degrees");
+
+        // What the view direction looks like from above.
+        auto const level = [](CameraKeyframe const& keyframe)
+        {
+            float3 const view = keyframe.target - keyframe.position;
+            return float2{view.x, view.z};
+        };
+
+        float2 const view = level(key);
+
+        if (not (view.length() > 1e-6f * (key.target - key.position).length()))
+            throw fail("the camera can't look straight up or down, or at its own position");
+
+        if (not path.empty())
+        {
+            // Between two keyframes the view passes through the vertical
+            // if, seen from above, it turns right around.
+            float2 const previous = level(path.back());
+
+            float const cross = previous.x * view.y - previous.y * view.x;
+
+            if (std::abs(cross) <= 1e-6f * previous.length() * view.length() and previous.dot(view) < 0)
+                throw fail("the camera would look straight up or down on the way from the keyframe before");
+        }
+
+        key.horizontal_fov *= std::numbers::pi_v<float> / 180;
+        path.push_back(key);
+    }
+
+    if (path.empty())
+        throw std::runtime_error("camera path without keyframes");
+
+    return path;
+}
+
+// Frame `frame` of `frames` spread evenly over the whole path.
+[[nodiscard]]
+inline Camera camera_on_path(
+    CameraPath const& path,
+    int        const  frame,
+    int        const  frames,
+    float      const  aspect_ratio)
+{
+    float const t = frames > 1
+        ? static_cast<float>(frame) / (frames - 1) * (path.size() - 1)
+        : 0;
+
+    auto  const k = std::min(static_cast<std::size_t>(t), path.size() - 1);
+    auto  const a = path[k];
+    auto  const b = path[std::min(k + 1, path.size() - 1)];
+    float const s = t - k;
+
+    float3 const position = (1 - s) * a.position + s * b.position;
+    float3 const target   = (1 - s) * a.target   + s * b.target;
+
+    return {
+        .position       = position,
+        .forward        = (target - position).normalize(),
+        .up             = {0, 1, 0},
+        .horizontal_fov = (1 - s) * a.horizontal_fov + s * b.horizontal_fov,
+        .aspect_ratio   = aspect_ratio,
+        .shift          = {},
+    };
+}
+
+struct BatchFrameTime
+{
+    double render {}; // Camera rays and shading, in ms.
+    double wait   {}; // Waiting for the previous frame to be written, in ms.
+};
+
+// Writes frames as numbered images, with name_pattern a printf pattern
+// with one %d for the frame number.
+[[nodiscard]]
+inline auto frame_files(
+    std::string const& name_pattern,
+    int         const  width,
+    int         const  height)
+{
+    return [=](int const frame, std::vector<float3> const& image)
+    {
+        char name[256];
+        std::snprintf(name, sizeof(name), name_pattern.c_str(), frame);
+
+        write_image(name, image, width, height);
+    };
+}
+
+/*
+** Renders frames [0, frames) of the path, hands each to
+** write_frame(frame, image) in order, and returns each frame's times.
+** write_frame runs on another thread, one frame at a time.
+*/
+template <typename Scene, typename Lights, typename WriteFrame> [[nodiscard]]
+std::vector<BatchFrameTime> render_batch(
+    ThreadPool&          pool,
+    CameraPath    const& path,
+    int           const  frames,
+    int           const  width,
+    int           const  height,
+    Scene         const& objects,
+    MaterialTable const& materials,
+    Lights        const& lights,
+    WriteFrame&&         write_frame)
+{
+    using clock = std::chrono::steady_clock;
+    using std::chrono::duration;
+
+    constexpr int band_rows = 8;
+
+    int const bands = (height + band_rows - 1) / band_rows;
+
+    std::vector<BatchFrameTime> times;
+
+    // Two images, so one is written while the other is rendered.
+    std::vector<float3> images[2] = {
+        std::vector<float3>(width * height),
+        std::vector<float3>(width * height),
+    };
+    std::future<void> writing;
+
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        auto const start = clock::now();
+        auto&      image = images[frame % 2];
+
+        auto const rays = make_camera_rays(
+            camera_on_path(path, frame, frames, static_cast<float>(width) / height),
+            width, height
+        );
+
+        std::latch rendered(bands);
+
+        for (int band = 0; band < bands; ++band)
+        {
+            pool.submit(0, [&, band]
+            {
+                int const first = band * band_rows;
+
+                render_rows(rays, first, std::min(band_rows, height - first),
+                    objects, materials, lights,
+                    image.data() + first * width
+                );
+
+                rendered.count_down();
+            });
+        }
+
+        rendered.wait();
+
+        auto const done = clock::now();
+
+        // One frame is written at a time, and the previous one has to be
+        // out before its image is rendered into again by the next frame.
+        if (writing.valid())
+            writing.get();
+
+        auto const written = clock::now();
+
+        writing = std::async(std::launch::async, [&write_frame, &image, frame]
+        {
+            write_frame(frame, image);
+        });
+
+        times.push_back({
+            .render = duration<double, std::milli>(done - start).count(),
+            .wait   = duration<double, std::milli>(written - done).count(),
+        });
+    }
+
+    if (writing.valid())
+        writing.get();
+
+    return times;
+}
+
+#endif // RENDERING_BATCH_H
@@ -0,0 +1,147 @@
+#ifndef RENDERING_CAMERA_H
+#define RENDERING_CAMERA_H
+
+#include <cmath>
+#include <vector>
+
+#include <linear_algebra.h>
+#include <rays/ray.h>
+
+struct Camera
+{
+    float3 position       {0, 0,  0};
+    float3 forward        {0, 0, -1};
+    float3 up             {0, 1,  0};
+    // Full horizontal field of view, in radians.
+    float  horizontal_fov {1.5708f};
+    // Width over height of the image plane.
+    float  aspect_ratio   {16.f / 9};
+    // Off-axis shift of the image plane, in units of its half-extent,
+    // for framing without tilting the camera.
+    float2 shift          {};
+};
+
+/*
+** The framing the main scene has always been rendered with: looking
+** down -z from the origin, with the image plane shifted down by 100
+** pixels at 1080p. The shift is a fraction of the image, so every
+** resolution frames the same picture.
+*/
+[[nodiscard]]
+inline Camera default_camera(
+    int const width,
+    int const height)
+{
+    return {
+        .horizontal_fov = 2 * std::atan(std::atan(3.1415f / 3)),
+        .aspect_ratio   = static_cast<float>(width) / height,
+        .shift          = {0, -100.f / 540},
+    };
+}
+
+/*
+** Precomputed ray generation for one camera and resolution.
+**
+** On an image plane one unit in front of the camera, the direction
+** through pixel (i, j) is
+**
+**      forward + v(j) * up + u(i) * right,
+**
+** so it splits into a per-row part and a per-column part, which are
+** computed once here. Generating a ray is then one addition and one
+** normalization.
+*/
+struct CameraRays
+{
+    int    width   {};
+    int    height  {};
+    float3 origin  {};
+
+    // The orthonormal camera basis and the pixel to image plane mapping
+    // u(i) = u0 + i * du, v(j) = v0 - j * dv, kept for projecting points.
+    float3 forward {};
+    float3 right   {};
+    float3 up      {};
+    float  u0      {};
+    float  du      {};
+    float  v0      {};
+    float  dv      {};
+
+    std::vector<float3> rows    {}; // forward + v(j) * up
+    std::vector<float3> columns {}; // u(i) * right
+};
+
+[[nodiscard]]
+inline CameraRays make_camera_rays(
+    Camera const& camera,
+    int    const  width,
+    int    const  height)
+{
+    float3 const forward = camera.forward.normalize();
+    float3 const right   = forward.cross(camera.up).normalize();
+    float3 const up      = right.cross(forward);
+
+    float const half_width  = width  / 2.f;
+    float const half_height = height / 2.f;
+    float const tan_x       = std::tan(camera.horizontal_fov / 2);
+    float const tan_y       = tan_x / camera.aspect_ratio;
+
+    CameraRays rays
+    {
+        .width   = width,
+        .height  = height,
+        .origin  = camera.position,
+        .forward = forward,
+        .right   = right,
+        .up      = up,
+        .u0      = tan_x * (camera.shift.x - 1),
+        .du      = tan_x / half_width,
+        .v0      = tan_y * (camera.shift.y + 1),
+        .dv      = tan_y / half_height,
+        .rows    = std::vector<float3>(height),
+        .columns = std::vector<float3>(width),
+    };
+
+    // Rows go top to bottom, so v decreases with j.
+    for (int j = 0; j < height; ++j)
+    {
+        float const v = tan_y * ((half_height - j) / half_height + camera.shift.y);
+        rays.rows[j] = forward + v * up;
+    }
+
+    for (int i = 0; i < width; ++i)
+    {
+        float const u = tan_x * ((i - half_width) / half_width + camera.shift.x);
+        rays.columns[i] = u * right;
+    }
+
+    return rays;
+}
+
+[[nodiscard]]
+inline Ray primary_ray(
+    CameraRays const& rays,
+    int        const  i,
+    int        const  j)
+{
+    return {rays.origin, (rays.rows[j] + rays.columns[i]).normalize()};
+}
+
+/*
+** The ray through a point inside pixel (i, j), offset in [0, 1)^2 from
+** the corner primary_ray goes through, for sampling the whole pixel.
+*/
+[[nodiscard]]
+inline Ray pixel_sample_ray(
+    CameraRays const& rays,
+    int        const  i,
+    int        const  j,
+    float2     const  offset)
+{
+    float const u = rays.u0 + (i + offset.x) * rays.du;
+    float const v = rays.v0 - (j + offset.y) * rays.dv;
+
+    return {rays.origin, (rays.forward + u * rays.right + v * rays.up).normalize()};
+}
+
+#endif // RENDERING_CAMERA_H
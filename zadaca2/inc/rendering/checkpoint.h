@@ -0,0 +1,299 @@
+#ifndef RENDERING_CHECKPOINT_H
+#define RENDERING_CHECKPOINT_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <rendering/progressive.h>
+
+/*
+** Progressive renders saved as they go, so one that is stopped can be
+** continued where it was.
+**
+** The file is mapped into memory and holds two copies of the render
+** state, slots, behind a header naming the one that is complete. A
+** checkpoint updates the other slot, copying only the tiles that moved
+** on since that slot was last written, flushes it, and only then
+** switches the header over to it. A render killed at any point, even
+** half way through a checkpoint, leaves the last complete one intact.
+**
+**      header  (4096 bytes)    CheckpointHeader, then zeros
+**      slot 0, slot 1          the passes of every tile, padded to a
+**                              page, then every tile's PixelAccumulators
+**
+** The header also records the resolution, tiling, sampler and a
+** fingerprint of the scene and camera, and a render only continues from
+** a checkpoint of the same render. The sampler's state is its settings
+** and each pixel's sample count: the next sample a pixel takes is a
+** pure function of those. Which pixels take one also depends on the
+** adaptive threshold, saved in the header with the active slot.
+*/
+constexpr char        checkpoint_magic[8]     = {'Z', 'C', 'K', 'P', 'T', '3', '\n', '\0'};
+constexpr std::size_t checkpoint_header_bytes = 4096;
+
+struct CheckpointHeader
+{
+    char          magic[8]          {};
+    std::uint32_t width             {};
+    std::uint32_t height            {};
+    std::uint32_t tile_size         {};
+    std::uint32_t samples_per_pixel {};
+    std::uint32_t sequence          {};
+    std::uint32_t seed              {};
+    std::uint64_t fingerprint       {};
+    // The slot holding the last complete checkpoint, and how many were
+    // written before it.
+    std::uint32_t active_slot       {};
+    std::uint32_t generation        {};
+    // The image's adaptive threshold as of that checkpoint.
+    float         threshold         {};
+    // Explicit, so no padding bytes go into the comparison of headers.
+    std::uint32_t reserved          {};
+};
+
+static_assert(sizeof(CheckpointHeader) == 56);
+
+[[nodiscard]]
+inline CheckpointHeader make_checkpoint_header(
+    ProgressiveImage const& image,
+    std::uint64_t    const  fingerprint)
+{
+    CheckpointHeader header {
+        .width             = static_cast<std::uint32_t>(image.sampler.width),
+        .height            = static_cast<std::uint32_t>(image.sampler.height),
+        .tile_size         = static_cast<std::uint32_t>(image.tile_size),
+        .samples_per_pixel = static_cast<std::uint32_t>(image.sampler.samples_per_pixel),
+        .sequence          = static_cast<std::uint32_t>(image.sampler.sequence),
+        .seed              = image.sampler.seed,
+        .fingerprint       = fingerprint,
+    };
+
+    std::memcpy(header.magic, checkpoint_magic, sizeof(checkpoint_magic));
+
+    return header;
+}
+
+struct CheckpointLayout
+{
+    std::size_t passes_bytes {};
+    std::size_t slot_bytes   {};
+    std::size_t file_bytes   {};
+};
+
+[[nodiscard]]
+inline CheckpointLayout checkpoint_layout(ProgressiveImage const& image)
+{
+    auto const page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+
+    auto const round_up = [page](std::size_t const bytes)
+    {
+        return (bytes + page - 1) / page * page;
+    };
+
+    std::size_t const passes_bytes = round_up(image.tile_passes.size() * sizeof(std::uint32_t));
+    std::size_t const slot_bytes   = round_up(passes_bytes + image.pixels.size() * sizeof(PixelAccumulator));
+
+    return {
+        .passes_bytes = passes_bytes,
+        .slot_bytes   = slot_bytes,
+        .file_bytes   = checkpoint_header_bytes + 2 * slot_bytes,
+    };
+}
+
+class RenderCheckpoint
+{
+public:
+    // Maps fd, a file already of checkpoint_layout(image).file_bytes.
+    RenderCheckpoint(
+        int              const  fd,
+        ProgressiveImage const& image)
+        : fd_     {fd}
+        , layout_ {checkpoint_layout(image)}
+    {
+        void* const mapping = ::mmap(nullptr, layout_.file_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+        if (mapping == MAP_FAILED)
+        {
+            int const error = errno;
+            ::close(fd);
+            throw std::system_error(error, std::system_category(), "mmap checkpoint");
+        }
+
+        data_ = static_cast<unsigned char*>(mapping);
+    }
+
+    RenderCheckpoint(RenderCheckpoint&& other) noexcept
+        : fd_     {std::exchange(other.fd_, -1)}
+        , data_   {std::exchange(other.data_, nullptr)}
+        , layout_ {other.layout_}
+    {}
+
+    RenderCheckpoint(RenderCheckpoint const&)            = delete;
+    RenderCheckpoint& operator=(RenderCheckpoint const&) = delete;
+
+    ~RenderCheckpoint()
+    {
+        if (data_)
+            ::munmap(data_, layout_.file_bytes);
+        if (fd_ >= 0)
+            ::close(fd_);
+    }
+
+    [[nodiscard]]
+    CheckpointHeader& header() noexcept
+    {
+        return *reinterpret_cast<CheckpointHeader*>(data_);
+    }
+
+    /*
+    ** Copies the active slot into image, which has to be of this render,
+    ** and marks every tile of the other slot stale. A save killed before
+    ** switching slots may have left that one part written, with tiles at
+    ** a pass count the continued render reaches again with different
+    ** pixels, the threshold being lowered by the clock; save would then
+    ** take them to be up to date.
+    */
+    void load(ProgressiveImage& image)
+    {
+        int const slot = static_cast<int>(header().active_slot);
+
+        std::copy_n(tile_passes(slot), image.tile_passes.size(), image.tile_passes.begin());
+        std::copy_n(pixels(slot),      image.pixels.size(),      image.pixels.begin());
+
+        std::fill_n(tile_passes(1 - slot), image.tile_passes.size(), std::numeric_limits<std::uint32_t>::max());
+    }
+
+    // Writes image's progress since the inactive slot's last checkpoint
+    // into it, and makes it the active one.
+    void save(ProgressiveImage const& image)
+    {
+        int const slot = 1 - static_cast<int>(header().active_slot);
+
+        std::uint32_t* const    passes    = tile_passes(slot);
+        PixelAccumulator* const tiles     = pixels(slot);
+        std::size_t const       tile_size = static_cast<std::size_t>(image.tile_size) * image.tile_size;
+
+        for (int k = 0; k < image.tile_count(); ++k)
+        {
+            if (passes[k] == image.tile_passes[k])
+                continue;
+
+            std::copy_n(image.pixels.data() + k * tile_size, tile_size, tiles + k * tile_size);
+            passes[k] = image.tile_passes[k];
+        }
+
+        // Only pages written to above are dirty, so only they go to disk.
+        if (::msync(data_ + checkpoint_header_bytes + slot * layout_.slot_bytes, layout_.slot_bytes, MS_SYNC) != 0)
+            throw std::system_error(errno, std::system_category(), "write checkpoint");
+
+        header().active_slot = static_cast<std::uint32_t>(slot);
+        header().threshold   = image.threshold;
+        ++header().generation;
+
+        if (::msync(data_, checkpoint_header_bytes, MS_SYNC) != 0)
+            throw std::system_error(errno, std::system_category(), "write checkpoint");
+    }
+
+private:
+    [[nodiscard]]
+    std::uint32_t* tile_passes(int const slot) noexcept
+    {
+        return reinterpret_cast<std::uint32_t*>(data_ + checkpoint_header_bytes + slot * layout_.slot_bytes);
+    }
+
+    [[nodiscard]]
+    PixelAccumulator* pixels(int const slot) noexcept
+    {
+        return reinterpret_cast<PixelAccumulator*>(data_ + checkpoint_header_bytes + slot * layout_.slot_bytes + layout_.passes_bytes);
+    }
+
+    int              fd_     {-1};
+    unsigned char*   data_   {};
+    CheckpointLayout layout_ {};
+};
+
+// A new checkpoint at path for image, with nothing rendered yet.
+[[nodiscard]]
+inline RenderCheckpoint create_checkpoint(
+    std::filesystem::path const& path,
+    ProgressiveImage      const& image,
+    std::uint64_t         const  fingerprint)
+{
+    int const fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        throw std::system_error(errno, std::system_category(), "open " + path.string());
+
+    // Sparse, and all zeros: both slots start out as no passes done.
+    if (::ftruncate(fd, static_cast<off_t>(checkpoint_layout(image).file_bytes)) != 0)
+    {
+        int const error = errno;
+        ::close(fd);
+        throw std::system_error(error, std::system_category(), "resize " + path.string());
+    }
+
+    RenderCheckpoint checkpoint(fd, image);
+
+    checkpoint.header() = make_checkpoint_header(image, fingerprint);
+
+    if (::msync(&checkpoint.header(), checkpoint_header_bytes, MS_SYNC) != 0)
+        throw std::system_error(errno, std::system_category(), "write " + path.string());
+
+    return checkpoint;
+}
+
+/*
+** Continues from the checkpoint at path: loads its last complete state
+** into image, made for the same render, and returns it to save further
+** checkpoints to. Throws if the file is a checkpoint of anything else.
+*/
+[[nodiscard]]
+inline RenderCheckpoint resume_checkpoint(
+    std::filesystem::path const& path,
+    ProgressiveImage&            image,
+    std::uint64_t         const  fingerprint)
+{
+    int const fd = ::open(path.c_str(), O_RDWR);
+    if (fd < 0)
+        throw std::system_error(errno, std::system_category(), "open " + path.string());
+
+    CheckpointHeader stored;
+
+    if (::pread(fd, &stored, sizeof(stored), 0) != static_cast<ssize_t>(sizeof(stored)))
+    {
+        ::close(fd);
+        throw std::runtime_error(path.string() + " is not a checkpoint");
+    }
+
+    auto expected = make_checkpoint_header(image, fingerprint);
+    expected.active_slot = stored.active_slot;
+    expected.generation  = stored.generation;
+    expected.threshold   = stored.threshold;
+
+    if (std::memcmp(&stored, &expected, sizeof(stored)) != 0 or stored.active_slot > 1
+        or ::lseek(fd, 0, SEEK_END) != static_cast<off_t>(checkpoint_layout(image).file_bytes))
+    {
+        ::close(fd);
+        throw std::runtime_error(path.string() + " is a checkpoint of a different render");
+    }
+
+    RenderCheckpoint checkpoint(fd, image);
+    checkpoint.load(image);
+    image.threshold = stored.threshold;
+
+    return checkpoint;
+}
+
+#endif // RENDERING_CHECKPOINT_H
@@ -0,0 +1,376 @@
+#ifndef RENDERING_DIRTY_TILES_H
+#define RENDERING_DIRTY_TILES_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <linear_algebra.h>
+#include <objects/object.h>
+#include <rays/ray.h>
+#include <rays/tracing.h>
+#include <rendering/camera.h>
+#include <rendering/render.h>
+#include <threading/parallel_for.h>
+
+/*
+** Incremental re-rendering after individual objects change.
+**
+** A pixel's colour can only change if some ray of its ray tree, as it
+** was traced last time, has a different result now. That happens in
+** exactly two ways:
+**
+**      (1) the ray's result was the changed object: it was the nearest
+**          hit of a camera or reflection ray, or the nearest object
+**          along a shadow ray;
+**      (2) the ray passes through where the object is now.
+**
+** For every tile we keep the set of objects that were a result (1),
+** and bound all its rays with a few beams (2): the rays are grouped by
+** the octant of their direction, and each group keeps the box of its
+** origins, the box of its directions and its longest ray. A changed
+** object whose new bounding box misses every beam and that isn't in
+** the set can't affect the tile, so its previous pixels are reused.
+**
+** Shadow and reflection rays are recorded by tracing through a
+** TrackedScene, so this works with every light type whose shadow rays
+** are nearest-hit queries on the scene: plain point lights, the light
+** tree and the SIMD light array. Shadow caster lists and shadow maps
+** bypass the scene and are not supported.
+*/
+struct RayBeam
+{
+    bool   empty          = true;
+    float3 origin_min     {};
+    float3 origin_max     {};
+    float3 direction_min  {};
+    float3 direction_max  {};
+    float  max_length     {};
+
+    void add(
+        Ray   const ray,
+        float const length) noexcept
+    {
+        if (empty)
+        {
+            empty         = false;
+            origin_min    = origin_max    = ray.source;
+            direction_min = direction_max = ray.direction;
+            max_length    = length;
+            return;
+        }
+
+        auto const lower = [](float3 const a, float3 const b) -> float3
+        {
+            return {std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z)};
+        };
+        auto const upper = [](float3 const a, float3 const b) -> float3
+        {
+            return {std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z)};
+        };
+
+        origin_min    = lower(origin_min   , ray.source);
+        origin_max    = upper(origin_max   , ray.source);
+        direction_min = lower(direction_min, ray.direction);
+        direction_max = upper(direction_max, ray.direction);
+        max_length    = std::max(max_length, length);
+    }
+};
+
+/*
+** Whether any ray of the beam may pass through the box.
+**
+** Origins and the box are both wrapped in spheres, and the directions
+** in a cone around the centre of their box. Moving the origin inside
+** its sphere is the same as growing the target sphere by its radius,
+** so we test a cone with a single apex against a sphere of radius
+** R + r0: they meet if the angle to the sphere's centre is within the
+** cone's half-angle plus the angle the sphere subtends.
+*/
+[[nodiscard]]
+inline bool beam_may_hit(
+    RayBeam     const& beam,
+    BoundingBox const  box)
+{
+    if (beam.empty)
+        return false;
+
+    float3 const origin        = 0.5 * (beam.origin_min + beam.origin_max);
+    float  const origin_radius = 0.5 * (beam.origin_max - beam.origin_min).length();
+    float3 const center        = 0.5 * (box.min + box.max);
+    float  const radius        = 0.5 * (box.max - box.min).length() + origin_radius;
+
+    float3 const to_center = center - origin;
+    float  const distance  = to_center.length();
+
+    if (distance <= radius)
+        return true;
+    if (distance - radius > beam.max_length)
+        return false;
+
+    float3 const axis_sum = 0.5 * (beam.direction_min + beam.direction_max);
+    if (axis_sum.length() < 1e-6f)
+        return true;
+
+    float3 const axis = axis_sum.normalize();
+
+    // Directions within a box are within the cone through its corners.
+    float cos_cone = 1;
+
+    for (int corner = 0; corner < 8; ++corner)
+    {
+        float3 const d = {
+            corner & 1 ? beam.direction_max.x : beam.direction_min.x,
+            corner & 2 ? beam.direction_max.y : beam.direction_min.y,
+            corner & 4 ? beam.direction_max.z : beam.direction_min.z,
+        };
+
+        if (d.length() < 1e-6f)
+            return true;
+
+        cos_cone = std::min(cos_cone, axis.dot(d.normalize()));
+    }
+
+    // Wider than a hemisphere; not worth bounding any tighter.
+    if (cos_cone <= 0)
+        return true;
+
+    float const cone_angle   = std::acos(cos_cone);
+    float const sphere_angle = std::asin(radius / distance);
+    float const angle        = std::acos(std::clamp(axis.dot(to_center) / distance, -1.f, 1.f));
+
+    return angle <= cone_angle + sphere_angle;
+}
+
+struct TileDependencies
+{
+    // Objects that were the result of at least one ray.
+    std::vector<bool> results {};
+
+    RayBeam camera_rays          {};
+    RayBeam secondary_rays[8]    {};
+
+    [[nodiscard]]
+    bool may_depend_on(
+        std::uint32_t const object,
+        BoundingBox   const bounds) const
+    {
+        if (results[object] or beam_may_hit(camera_rays, bounds))
+            return true;
+
+        for (auto const& beam : secondary_rays)
+        {
+            if (beam_may_hit(beam, bounds))
+                return true;
+        }
+
+        return false;
+    }
+};
+
+struct TrackedFrame
+{
+    static constexpr int tile_size = 32;
+
+    int width  {};
+    int height {};
+
+    CameraRays rays {};
+
+    // The scene's primitives, in the order dependency sets refer to them.
+    std::vector<Object const*>    objects {};
+    std::vector<float3>           image   {};
+    std::vector<TileDependencies> tiles   {};
+
+    [[nodiscard]]
+    int tiles_x() const noexcept
+    {
+        return (width + tile_size - 1) / tile_size;
+    }
+
+    [[nodiscard]]
+    int tiles_y() const noexcept
+    {
+        return (height + tile_size - 1) / tile_size;
+    }
+};
+
+struct TileRecorder
+{
+    TrackedFrame const* frame {};
+    TileDependencies*   tile  {};
+
+    void record(
+        RayBeam&                           beam,
+        Ray                         const  ray,
+        Object::RayIntersectionData const& data)
+    {
+        if (not data.intersected_object)
+        {
+            beam.add(ray, std::numeric_limits<float>::infinity());
+            return;
+        }
+
+        beam.add(ray, data.intersection_distance);
+
+        for (std::size_t k = 0; k < frame->objects.size(); ++k)
+        {
+            if (frame->objects[k] == data.intersected_object)
+                tile->results[k] = true;
+        }
+    }
+};
+
+// The tile the calling thread is rendering, if any.
+[[nodiscard]]
+inline TileRecorder& current_tile_recorder()
+{
+    thread_local TileRecorder recorder;
+    return recorder;
+}
+
+/*
+** A scene that reports every ray traced through it to the tile being
+** rendered on the calling thread.
+*/
+template <typename Scene>
+struct TrackedScene
+{
+    Scene const& scene;
+};
+
+template <typename Scene> [[nodiscard]]
+Object::RayIntersectionData get_nearest_ray_intersection_data(
+    Ray                 const  ray,
+    TrackedScene<Scene> const& tracked)
+{
+    auto const data = get_nearest_ray_intersection_data(ray, tracked.scene);
+
+    auto& recorder = current_tile_recorder();
+
+    if (recorder.tile)
+    {
+        auto const d = ray.direction;
+        auto const octant = (d.x < 0 ? 1 : 0) | (d.y < 0 ? 2 : 0) | (d.z < 0 ? 4 : 0);
+
+        recorder.record(recorder.tile->secondary_rays[octant], ray, data);
+    }
+
+    return data;
+}
+
+template <typename Scene> [[nodiscard]]
+std::vector<Object const*> scene_objects(TrackedScene<Scene> const& tracked)
+{
+    return scene_objects(tracked.scene);
+}
+
+template <int w, int h, typename Scene, typename Lights>
+void render_tracked_tile(
+    TrackedFrame&        frame,
+    std::size_t   const  tile,
+    Scene         const& objects,
+    MaterialTable const& materials,
+    Lights        const& lights)
+{
+    auto& dependencies = frame.tiles[tile];
+    dependencies = {};
+    dependencies.results.assign(frame.objects.size(), false);
+
+    auto& recorder = current_tile_recorder();
+    recorder = {&frame, &dependencies};
+
+    TrackedScene<Scene> const tracked {objects};
+
+    int const x0 = static_cast<int>(tile) % frame.tiles_x() * TrackedFrame::tile_size;
+    int const y0 = static_cast<int>(tile) / frame.tiles_x() * TrackedFrame::tile_size;
+    int const x1 = std::min(x0 + TrackedFrame::tile_size, w);
+    int const y1 = std::min(y0 + TrackedFrame::tile_size, h);
+
+    for (int j = y0; j < y1; ++j)
+    {
+        for (int i = x0; i < x1; ++i)
+        {
+            Ray const ray = primary_ray(frame.rays, i, j);
+
+            auto const data = get_nearest_ray_intersection_data(ray, objects);
+            recorder.record(dependencies.camera_rays, ray, data);
+
+            frame.image[j * w + i] = data.intersected_object
+                ? trace_hit<max_trace_depth>(ray, data, tracked, materials, lights)
+                : float3{0, 0, 0};
+        }
+    }
+
+    recorder = {};
+}
+
+// Full render that also records every tile's dependencies.
+template <int w, int h, typename Scene, typename Lights> [[nodiscard]]
+TrackedFrame render_tracked(
+    Camera        const& camera,
+    Scene         const& objects,
+    MaterialTable const& materials,
+    Lights        const& lights)
+{
+    TrackedFrame frame
+    {
+        .width   = w,
+        .height  = h,
+        .rays    = make_camera_rays(camera, w, h),
+        .objects = scene_objects(objects),
+        .image   = std::vector<float3>(w * h),
+        .tiles   = {},
+    };
+    frame.tiles.resize(frame.tiles_x() * frame.tiles_y());
+
+    parallel_for(frame.tiles.size(), [&](std::size_t const tile)
+    {
+        render_tracked_tile<w, h>(frame, tile, objects, materials, lights);
+    });
+
+    return frame;
+}
+
+/*
+** Re-renders only the tiles that the changed objects may affect. The
+** objects are expected to have been modified in place, so `changed`
+** holds their indices in frame.objects. Returns the number of tiles
+** rendered again.
+*/
+template <int w, int h, typename Scene, typename Lights>
+std::size_t rerender_changed(
+    TrackedFrame&                     frame,
+    Scene                      const& objects,
+    MaterialTable              const& materials,
+    Lights                     const& lights,
+    std::vector<std::uint32_t> const& changed)
+{
+    std::vector<std::size_t> dirty;
+
+    for (std::size_t tile = 0; tile < frame.tiles.size(); ++tile)
+    {
+        for (auto const object : changed)
+        {
+            auto const bounds = frame.objects[object]->bounding_box();
+
+            if (frame.tiles[tile].may_depend_on(object, bounds))
+            {
+                dirty.push_back(tile);
+                break;
+            }
+        }
+    }
+
+    parallel_for(dirty.size(), [&](std::size_t const i)
+    {
+        render_tracked_tile<w, h>(frame, dirty[i], objects, materials, lights);
+    });
+
+    return dirty.size();
+}
+
+#endif // RENDERING_DIRTY_TILES_H
@@ -0,0 +1,135 @@
+#ifndef RENDERING_GBUFFER_H
+#define RENDERING_GBUFFER_H
+
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <linear_algebra.h>
+#include <objects/object.h>
+#include <rays/ray.h>
+#include <rays/tracing.h>
+#include <rendering/camera.h>
+#include <rendering/render.h>
+#include <threading/parallel_for.h>
+
+/*
+** Everything about a pixel's primary hit that shading needs. As long
+** as neither the camera nor the geometry change, these stay valid and
+** only lighting has to be recomputed.
+*/
+struct GBufferSample
+{
+    static constexpr std::uint32_t no_object
+        = std::numeric_limits<std::uint32_t>::max();
+
+    std::uint32_t object   = no_object; // Index into GBuffer::objects.
+    MaterialIndex material {};
+    float         distance {};
+    float3        position {};
+    float3        normal   {};
+};
+
+struct GBuffer
+{
+    int width  {};
+    int height {};
+
+    CameraRays rays {};
+
+    // The scene's primitives, in the order sample ids refer to them.
+    std::vector<Object const*>  objects {};
+    std::vector<GBufferSample>  samples {};
+};
+
+template <int w, int h, typename Scene> [[nodiscard]]
+GBuffer render_gbuffer(
+    Camera const& camera,
+    Scene  const& scene)
+{
+    GBuffer gbuffer
+    {
+        .width   = w,
+        .height  = h,
+        .rays    = make_camera_rays(camera, w, h),
+        .objects = scene_objects(scene),
+        .samples = std::vector<GBufferSample>(w * h),
+    };
+
+    parallel_for(h, [&](std::size_t const j)
+    {
+        for (int i = 0; i < w; ++i)
+        {
+            auto const data = get_nearest_ray_intersection_data(
+                primary_ray(gbuffer.rays, i, static_cast<int>(j)),
+                scene
+            );
+
+            if (not data.intersected_object)
+                continue;
+
+            auto& sample = gbuffer.samples[j * w + i];
+
+            // Primitives are few, so a linear search is fine here.
+            for (std::uint32_t k = 0; k < gbuffer.objects.size(); ++k)
+            {
+                if (gbuffer.objects[k] == data.intersected_object)
+                    sample.object = k;
+            }
+
+            sample.material = data.intersected_object->material;
+            sample.distance = data.intersection_distance;
+            sample.position = data.intersection_point;
+            sample.normal   = data.intersection_normal;
+        }
+    });
+
+    return gbuffer;
+}
+
+/*
+** Renders the frame from a G-buffer made with the same camera and
+** geometry, skipping all primary rays. Lights and materials are free to
+** change in between, the scene passed here is only used for shadow and
+** reflection rays.
+*/
+template <int w, int h, typename Scene, typename Lights> [[nodiscard]]
+std::vector<float3> relight(
+    GBuffer       const& gbuffer,
+    Scene         const& objects,
+    MaterialTable const& materials,
+    Lights        const& lights)
+{
+    assert(gbuffer.width == w and gbuffer.height == h);
+
+    std::vector<float3> image(w * h);
+
+    parallel_for(h, [&](std::size_t const j)
+    {
+        for (int i = 0; i < w; ++i)
+        {
+            auto const& sample = gbuffer.samples[j * w + i];
+
+            if (sample.object == GBufferSample::no_object)
+                continue;
+
+            Object::RayIntersectionData const data
+            {
+                .intersected_object    = gbuffer.objects[sample.object],
+                .intersection_distance = sample.distance,
+                .intersection_point    = sample.position,
+                .intersection_normal   = sample.normal,
+            };
+
+            image[j * w + i] = trace_hit<max_trace_depth>(
+                primary_ray(gbuffer.rays, i, static_cast<int>(j)),
+                data, objects, materials, lights
+            );
+        }
+    });
+
+    return image;
+}
+
+#endif // RENDERING_GBUFFER_H
@@ -0,0 +1,381 @@
+#ifndef RENDERING_PROGRESSIVE_H
+#define RENDERING_PROGRESSIVE_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include <linear_algebra.h>
+#include <objects/object.h>
+#include <output/tiled_image.h>
+#include <rays/tracing.h>
+#include <rendering/camera.h>
+#include <rendering/render.h>
+#include <sampling/sampler.h>
+#include <threading/thread_pool.h>
+
+/*
+** Many samples per pixel, taken in passes over the whole image.
+**
+** Every pass takes the next sample of every pixel, at a point in the
+** pixel given by the sampler, and adds it to the pixel's running sum.
+** A pixel's samples are always added in the same order, whichever
+** thread takes them, so the sums are the same to the bit however a
+** render is split up, stopped and continued.
+**
+** Pixels are kept tile by tile, as in a tiled image, so the state of a
+** tile is one contiguous block that can be copied out in one go.
+**
+** Sampling can be adaptive. Most pixels, on the floor or the empty
+** background, agree with themselves after a few samples, while those on
+** edges, shadow boundaries and reflections keep changing. Every pixel
+** tracks the variance of its samples' luminance, and once it has
+** min_samples it stops as soon as the standard error of its mean falls
+** below error_threshold. Within a pass, tiles go in order of their
+** remaining error, largest first, so a render cut short by its time
+** budget has spent it where the image was worst.
+**
+** Whether a pixel takes a sample depends on its own samples so far and
+** on the threshold, the same for every pixel of a pass. Without a time
+** budget the threshold is fixed, and adaptive renders are as repeatable
+** as uniform ones. Under one it is lowered between passes, as pixels
+** fall below it, and it is kept in the image with the pixels, so a
+** render continued from a checkpoint goes on with the threshold it had
+** reached rather than starting over from error_threshold.
+*/
+struct PixelAccumulator
+{
+    float3        sum               {};
+    std::uint32_t samples           {};
+    // Sum of the samples' squared luminance, for their variance.
+    float         luminance_squares {};
+};
+
+struct ProgressiveSettings
+{
+    // Adaptive sampling, in 8 bit levels of luminance; 0 takes every
+    // sample of every pixel.
+    float                     error_threshold     = 0;
+    int                       min_samples         = 8;
+    // Stop once this much time is up, whatever is left; 0 for no limit.
+    std::chrono::milliseconds time_budget         {0};
+    std::chrono::milliseconds checkpoint_interval = std::chrono::seconds(60);
+};
+
+[[nodiscard]]
+constexpr float luminance(float3 const color) noexcept
+{
+    return 0.2126f * color.x + 0.7152f * color.y + 0.0722f * color.z;
+}
+
+// Standard error of the pixel's mean luminance, infinite until it has
+// two samples to estimate it from.
+[[nodiscard]]
+inline float pixel_error(PixelAccumulator const& pixel) noexcept
+{
+    if (pixel.samples < 2)
+        return std::numeric_limits<float>::infinity();
+
+    float const n        = static_cast<float>(pixel.samples);
+    float const mean     = luminance(pixel.sum) / n;
+    float const variance = std::max(0.f, (pixel.luminance_squares - n * mean * mean) / (n - 1));
+
+    return std::sqrt(variance / n);
+}
+
+struct ProgressiveImage
+{
+    // Resolution, samples per pixel and the sequence they come from.
+    Sampler                       sampler     {};
+    int                           tile_size   {};
+    // tile_size * tile_size pixels for every tile, in rows.
+    std::vector<PixelAccumulator> pixels      {};
+    // Passes each tile has finished.
+    std::vector<std::uint32_t>    tile_passes {};
+    // The error threshold adaptive sampling has come down to, 0 until
+    // a render starts with one.
+    float                         threshold   {};
+
+    [[nodiscard]]
+    int tiles_across() const noexcept
+    {
+        return (sampler.width + tile_size - 1) / tile_size;
+    }
+
+    [[nodiscard]]
+    int tile_count() const noexcept
+    {
+        return static_cast<int>(tile_passes.size());
+    }
+
+    [[nodiscard]]
+    TileRect tile_rect(int const k) const noexcept
+    {
+        int const x0 = (k % tiles_across()) * tile_size;
+        int const y0 = (k / tiles_across()) * tile_size;
+
+        return {x0, y0, std::min(x0 + tile_size, sampler.width), std::min(y0 + tile_size, sampler.height)};
+    }
+
+    [[nodiscard]]
+    PixelAccumulator* tile(int const k) noexcept
+    {
+        return pixels.data() + static_cast<std::size_t>(k) * tile_size * tile_size;
+    }
+};
+
+[[nodiscard]]
+inline ProgressiveImage make_progressive_image(
+    Sampler const& sampler,
+    int     const  tile_size = 32)
+{
+    if (sampler.width <= 0 or sampler.height <= 0 or tile_size <= 0)
+        throw std::invalid_argument("progressive image needs a positive size and tile size");
+
+    int const tiles = ((sampler.width  + tile_size - 1) / tile_size)
+                    * ((sampler.height + tile_size - 1) / tile_size);
+
+    return {
+        .sampler     = sampler,
+        .tile_size   = tile_size,
+        .pixels      = std::vector<PixelAccumulator>(static_cast<std::size_t>(tiles) * tile_size * tile_size),
+        .tile_passes = std::vector<std::uint32_t>(tiles, 0),
+    };
+}
+
+// The image so far, each pixel the mean of its samples, in rows.
+[[nodiscard]]
+inline std::vector<float3> resolve_progressive_image(ProgressiveImage& image)
+{
+    int const width = image.sampler.width;
+
+    std::vector<float3> out(static_cast<std::size_t>(width) * image.sampler.height);
+
+    for (int k = 0; k < image.tile_count(); ++k)
+    {
+        auto const              rect   = image.tile_rect(k);
+        PixelAccumulator const* pixels = image.tile(k);
+
+        for (int y = rect.y0; y < rect.y1; ++y)
+        {
+            for (int x = rect.x0; x < rect.x1; ++x)
+            {
+                auto const& pixel = pixels[(y - rect.y0) * image.tile_size + (x - rect.x0)];
+
+                if (pixel.samples > 0)
+                    out[static_cast<std::size_t>(y) * width + x] = (1.f / pixel.samples) * pixel.sum;
+            }
+        }
+    }
+
+    return out;
+}
+
+/*
+** Takes the passes image hasn't finished yet, tiles on the pool, and
+** returns the number of samples taken. Every checkpoint interval, and
+** once at the end, checkpoint is called with image consistent, every
+** tile either done with a pass or not started on it; tiles are held
+** back meanwhile.
+*/
+template <typename Scene, typename Lights>
+std::uint64_t render_progressive(
+    ThreadPool&                                  pool,
+    Camera                                const& camera,
+    ProgressiveImage&                            image,
+    Scene                                 const& objects,
+    MaterialTable                         const& materials,
+    Lights                                const& lights,
+    ProgressiveSettings                   const  settings   = {},
+    std::function<void(ProgressiveImage const&)> checkpoint = {})
+{
+    using clock = std::chrono::steady_clock;
+
+    auto const rays   = make_camera_rays(camera, image.sampler.width, image.sampler.height);
+    int  const passes = image.sampler.samples_per_pixel;
+
+    auto const deadline = settings.time_budget.count() > 0
+        ? clock::now() + settings.time_budget
+        : clock::time_point::max();
+
+    // Under a time budget, the threshold is halved whenever fewer than
+    // an eighth of the pixels are above it, so the time left over still
+    // goes to the worst pixels rather than to nothing, down to a floor
+    // past which the error is far below a level of the output. It is
+    // only changed between passes.
+    if (image.threshold <= 0)
+        image.threshold = settings.error_threshold;
+
+    float&      threshold     = image.threshold;
+    float const min_threshold = settings.error_threshold / 256;
+
+    // Whether pixel still wants samples.
+    auto const sampling = [&](PixelAccumulator const& pixel)
+    {
+        return threshold <= 0
+            or static_cast<int>(pixel.samples) < settings.min_samples
+            or pixel_error(pixel) > threshold;
+    };
+
+    std::mutex              mutex;
+    std::condition_variable finished;
+    std::atomic<bool>       out_of_time = false;
+    std::uint64_t           taken       = 0;
+
+    auto next_checkpoint = clock::now() + settings.checkpoint_interval;
+
+    auto const save = [&]
+    {
+        if (checkpoint)
+            checkpoint(image);
+
+        next_checkpoint = clock::now() + settings.checkpoint_interval;
+    };
+
+    for (int pass = *std::min_element(image.tile_passes.begin(), image.tile_passes.end());
+         pass < passes and not out_of_time; ++pass)
+    {
+        // The tiles left in this pass, a resumed render may be part way
+        // through it, with the largest error first.
+        std::vector<int>   tiles;
+        std::vector<float> errors(image.tile_count());
+
+        while (true)
+        {
+            std::size_t wanted = 0;
+            std::size_t total  = 0;
+
+            tiles.clear();
+            std::fill(errors.begin(), errors.end(), 0.f);
+
+            for (int k = 0; k < image.tile_count(); ++k)
+            {
+                if (static_cast<int>(image.tile_passes[k]) != pass)
+                    continue;
+
+                tiles.push_back(k);
+
+                auto const              rect   = image.tile_rect(k);
+                PixelAccumulator const* pixels = image.tile(k);
+
+                for (int j = 0; j < rect.y1 - rect.y0; ++j)
+                {
+                    for (int i = 0; i < rect.x1 - rect.x0; ++i)
+                    {
+                        auto const& pixel = pixels[j * image.tile_size + i];
+
+                        ++total;
+
+                        if (sampling(pixel))
+                        {
+                            errors[k] += std::min(pixel_error(pixel), std::numeric_limits<float>::max());
+                            ++wanted;
+                        }
+                    }
+                }
+            }
+
+            if (deadline == clock::time_point::max() or threshold / 2 < min_threshold or wanted * 8 >= total)
+                break;
+
+            threshold /= 2;
+        }
+
+        std::stable_sort(tiles.begin(), tiles.end(), [&](int const a, int const b)
+        {
+            return errors[a] > errors[b];
+        });
+
+        int remaining = static_cast<int>(tiles.size());
+
+        for (int const k : tiles)
+        {
+            pool.submit(0, [&, k, pass]
+            {
+                thread_local std::vector<float3> samples;
+
+                auto const rect  = image.tile_rect(k);
+                int  const width = rect.x1 - rect.x0;
+
+                PixelAccumulator* const pixels = image.tile(k);
+
+                if (clock::now() > deadline)
+                    out_of_time = true;
+
+                // Only this task touches the tile's pixels until it is
+                // done, so reading them outside the lock is safe.
+                bool const skip = out_of_time;
+
+                samples.resize(width * (rect.y1 - rect.y0));
+
+                for (int y = rect.y0; y < rect.y1 and not skip; ++y)
+                {
+                    for (int x = rect.x0; x < rect.x1; ++x)
+                    {
+                        auto const& pixel = pixels[(y - rect.y0) * image.tile_size + (x - rect.x0)];
+
+                        if (not sampling(pixel))
+                            continue;
+
+                        auto       sampler = start_pixel_sample(image.sampler, x, y, static_cast<int>(pixel.samples));
+                        auto const ray     = pixel_sample_ray(rays, x, y, sampler.next_2d());
+
+                        samples[(y - rect.y0) * width + (x - rect.x0)]
+                            = trace<max_trace_depth>(ray, objects, materials, lights);
+                    }
+                }
+
+                std::lock_guard const lock(mutex);
+
+                if (not skip)
+                {
+                    for (int j = 0; j < rect.y1 - rect.y0; ++j)
+                    {
+                        for (int i = 0; i < width; ++i)
+                        {
+                            auto& pixel = pixels[j * image.tile_size + i];
+
+                            if (not sampling(pixel))
+                                continue;
+
+                            float3 const sample = samples[j * width + i];
+
+                            pixel.sum               += sample;
+                            pixel.luminance_squares += luminance(sample) * luminance(sample);
+                            ++pixel.samples;
+                            ++taken;
+                        }
+                    }
+
+                    image.tile_passes[k] = pass + 1;
+                }
+
+                if (--remaining == 0)
+                    finished.notify_one();
+            });
+        }
+
+        std::unique_lock lock(mutex);
+
+        while (remaining > 0)
+        {
+            if (finished.wait_until(lock, next_checkpoint) == std::cv_status::timeout)
+                save();
+        }
+    }
+
+    std::lock_guard const lock(mutex);
+    save();
+
+    return taken;
+}
+
+#endif // RENDERING_PROGRESSIVE_H
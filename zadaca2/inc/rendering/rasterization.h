@@ -0,0 +1,209 @@
+#ifndef RENDERING_RASTERIZATION_H
+#define RENDERING_RASTERIZATION_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <linear_algebra.h>
+#include <objects/object.h>
+#include <rays/ray.h>
+#include <rendering/camera.h>
+#include <rendering/gbuffer.h>
+#include <threading/parallel_for.h>
+
+/*
+** Primary visibility by rasterization instead of ray casting.
+**
+** The scene is made of analytic primitives, not triangles, so there is
+** no edge function to rasterize with. Instead every primitive's bounding
+** box is projected to a pixel rectangle once, and each pixel is only
+** tested against the primitives whose rectangle covers it; coverage and
+** depth are then resolved exactly by the primitive's own intersection.
+** A pixel ends up with the same nearest hit as a camera ray would find,
+** but most primitives are never looked at for most pixels.
+*/
+struct ScreenRect
+{
+    int x0 {}; // Inclusive.
+    int y0 {};
+    int x1 {}; // Exclusive.
+    int y1 {};
+
+    [[nodiscard]]
+    constexpr bool empty() const noexcept
+    {
+        return x0 >= x1 or y0 >= y1;
+    }
+
+    [[nodiscard]]
+    constexpr bool overlaps(ScreenRect const other) const noexcept
+    {
+        return x0 < other.x1 and other.x0 < x1
+           and y0 < other.y1 and other.y0 < y1;
+    }
+};
+
+/*
+** The pixels whose camera rays may hit the box. A point at depth
+** z = d . forward lands on the image plane at
+**
+**      u = (d . right) / z,  v = (d . up) / z,
+**
+** and the pixel mapping inverts to i = (u - u0) / du, j = (v0 - v) / dv.
+** A box reaching behind the image plane has no finite projection, so it
+** conservatively covers the whole screen.
+*/
+[[nodiscard]]
+inline ScreenRect screen_bounds(
+    CameraRays  const& rays,
+    BoundingBox const  box)
+{
+    ScreenRect const screen {0, 0, rays.width, rays.height};
+
+    float i_min =  INFINITY, i_max = -INFINITY;
+    float j_min =  INFINITY, j_max = -INFINITY;
+
+    int behind = 0;
+
+    for (int corner = 0; corner < 8; ++corner)
+    {
+        float3 const p = {
+            corner & 1 ? box.max.x : box.min.x,
+            corner & 2 ? box.max.y : box.min.y,
+            corner & 4 ? box.max.z : box.min.z,
+        };
+
+        float3 const d = p - rays.origin;
+        float  const z = d.dot(rays.forward);
+
+        if (z <= 1e-3f)
+        {
+            ++behind;
+            continue;
+        }
+
+        float const i = (d.dot(rays.right) / z - rays.u0) / rays.du;
+        float const j = (rays.v0 - d.dot(rays.up) / z) / rays.dv;
+
+        i_min = std::min(i_min, i);
+        i_max = std::max(i_max, i);
+        j_min = std::min(j_min, j);
+        j_max = std::max(j_max, j);
+    }
+
+    if (behind == 8)
+        return {};
+    if (behind > 0)
+        return screen;
+
+    // Rays pass through integer pixel coordinates; one pixel of slack
+    // covers rounding in the projection.
+    auto const clamp = [](float const x, int const hi)
+    {
+        return static_cast<int>(std::clamp(x, 0.f, static_cast<float>(hi)));
+    };
+
+    return {
+        .x0 = clamp(std::floor(i_min) - 1, rays.width),
+        .y0 = clamp(std::floor(j_min) - 1, rays.height),
+        .x1 = clamp(std::ceil (i_max) + 2, rays.width),
+        .y1 = clamp(std::ceil (j_max) + 2, rays.height),
+    };
+}
+
+/*
+** Fills a G-buffer by rasterizing the scene's primitives, one tile per
+** task. Gives the same result as render_gbuffer(), so relight() can
+** shade it with only shadow and reflection rays left to trace.
+*/
+template <int w, int h, typename Scene> [[nodiscard]]
+GBuffer rasterize_gbuffer(
+    Camera const& camera,
+    Scene  const& scene)
+{
+    constexpr int tile_size = 32;
+    constexpr int tiles_x   = (w + tile_size - 1) / tile_size;
+    constexpr int tiles_y   = (h + tile_size - 1) / tile_size;
+
+    GBuffer gbuffer
+    {
+        .width   = w,
+        .height  = h,
+        .rays    = make_camera_rays(camera, w, h),
+        .objects = scene_objects(scene),
+        .samples = std::vector<GBufferSample>(w * h),
+    };
+
+    std::vector<ScreenRect> bounds;
+    bounds.reserve(gbuffer.objects.size());
+
+    for (auto const* object : gbuffer.objects)
+        bounds.push_back(screen_bounds(gbuffer.rays, object->bounding_box()));
+
+    parallel_for(tiles_x * tiles_y, [&](std::size_t const tile)
+    {
+        ScreenRect const rect
+        {
+            .x0 = static_cast<int>(tile) % tiles_x * tile_size,
+            .y0 = static_cast<int>(tile) / tiles_x * tile_size,
+            .x1 = std::min((static_cast<int>(tile) % tiles_x + 1) * tile_size, w),
+            .y1 = std::min((static_cast<int>(tile) / tiles_x + 1) * tile_size, h),
+        };
+
+        // Scene order is kept, so ties in depth resolve the same way as
+        // in get_nearest_ray_intersection_data().
+        std::vector<std::uint32_t> binned;
+
+        for (std::uint32_t k = 0; k < bounds.size(); ++k)
+        {
+            if (bounds[k].overlaps(rect))
+                binned.push_back(k);
+        }
+
+        if (binned.empty())
+            return;
+
+        for (int j = rect.y0; j < rect.y1; ++j)
+        {
+            for (int i = rect.x0; i < rect.x1; ++i)
+            {
+                Ray const ray = primary_ray(gbuffer.rays, i, j);
+
+                auto  nearest = Object::RayIntersectionData{.intersection_distance = 20000};
+                auto& sample  = gbuffer.samples[j * w + i];
+
+                for (auto const k : binned)
+                {
+                    auto const& b = bounds[k];
+
+                    if (i < b.x0 or i >= b.x1 or j < b.y0 or j >= b.y1)
+                        continue;
+
+                    auto const data = gbuffer.objects[k]->get_ray_intersection_data(ray);
+                    auto const d    = data.intersection_distance;
+
+                    if (0 < d and d < nearest.intersection_distance)
+                    {
+                        nearest       = data;
+                        sample.object = k;
+                    }
+                }
+
+                if (sample.object == GBufferSample::no_object)
+                    continue;
+
+                sample.material = nearest.intersected_object->material;
+                sample.distance = nearest.intersection_distance;
+                sample.position = nearest.intersection_point;
+                sample.normal   = nearest.intersection_normal;
+            }
+        }
+    });
+
+    return gbuffer;
+}
+
+#endif // RENDERING_RASTERIZATION_H
@@ -0,0 +1,78 @@
+#ifndef RENDERING_RENDER_H
+#define RENDERING_RENDER_H
+
+#include <vector>
+
+#include <linear_algebra.h>
+#include <objects/object.h>
+#include <lights/point_light.h>
+#include <rays/ray.h>
+#include <rays/tracing.h>
+#include <rendering/camera.h>
+
+/*
+** Maximum number of bounces along a camera ray, the primary hit
+** included.
+*/
+constexpr int max_trace_depth = 16;
+
+/*
+** Renders the pixels [x0, x1) x [y0, y1) of the image into out, row by
+** row, (x1 - x0) pixels to a row.
+*/
+template <typename Scene, typename Lights>
+void render_tile(
+    CameraRays    const& rays,
+    int           const  x0,
+    int           const  y0,
+    int           const  x1,
+    int           const  y1,
+    Scene         const& objects,
+    MaterialTable const& materials,
+    Lights        const& lights,
+    float3*       const  out)
+{
+    int const w = x1 - x0;
+
+    for (int j = y0; j < y1; ++j)
+    {
+        for (int i = x0; i < x1; ++i)
+            out[(j - y0) * w + (i - x0)] = trace<max_trace_depth>(primary_ray(rays, i, j), objects, materials, lights);
+    }
+}
+
+// Rows [first, first + count) of the image, whole.
+template <typename Scene, typename Lights>
+void render_rows(
+    CameraRays    const& rays,
+    int           const  first,
+    int           const  count,
+    Scene         const& objects,
+    MaterialTable const& materials,
+    Lights        const& lights,
+    float3*       const  out)
+{
+    render_tile(rays, 0, first, rays.width, first + count, objects, materials, lights, out);
+}
+
+template <
+    int w, int h,
+    typename Scene  = std::vector<Object const*>,
+    typename Lights = std::vector<PointLight>
+> [[nodiscard]]
+std::vector<float3> render(
+    Camera        const& camera,
+    Scene         const& objects,
+    MaterialTable const& materials,
+    Lights        const& lights)
+{
+    auto const rays = make_camera_rays(camera, w, h);
+
+    std::vector<float3> image(w * h);
+
+    render_rows(rays, 0, h, objects, materials, lights, image.data());
+
+    return image;
+}
+
+#endif // RENDERING_RENDER_H
@@ -0,0 +1,285 @@
+#ifndef RENDERING_RENDER_CACHE_H
+#define RENDERING_RENDER_CACHE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include <linear_algebra.h>
+#include <objects/object.h>
+#include <lights/point_light.h>
+#include <rendering/camera.h>
+
+/*
+** Content addressed cache of finished renders.
+**
+** A render is named by the hash of a canonical description of
+** everything its pixels depend on: the primitives with their materials
+** inlined, the lights, the camera, the resolution and the renderer's
+** settings. Primitives and lights are sorted, so listing them in
+** another order, or numbering the materials differently, still finds
+** the same entry.
+**
+** Each entry is a pair of files in the cache directory, the image as
+** <hash>.ppm (or .png, .pfm, as it was written) and <hash>.key with the
+** description, which is compared on
+** lookup so a hash collision is a miss rather than a wrong image. An
+** entry's modification time is when it was last used, and once the
+** directory grows past its limit the least recently used entries go.
+**
+** The cache only ever speeds things up: if the directory can't be read
+** or written, lookups miss and stores are dropped.
+*/
+struct RenderCache
+{
+    std::filesystem::path directory {};
+    std::uintmax_t        max_bytes {std::uintmax_t{1} << 30};
+};
+
+struct RenderKey
+{
+    std::string description {};
+    std::string name        {}; // Hash of the description, in hex.
+};
+
+[[nodiscard]]
+inline std::string canonical_form(Material const& material)
+{
+    return canonical_record("material", {
+        material.diffuse_color.x, material.diffuse_color.y, material.diffuse_color.z,
+        material.diffuse_coefficient,
+        material.specular_coefficient,
+        material.specular_exponent,
+        material.reflectivity,
+    });
+}
+
+[[nodiscard]]
+inline std::string canonical_form(PointLight const& light)
+{
+    return canonical_record("light", {
+        light.position.x, light.position.y, light.position.z, light.intensity
+    });
+}
+
+[[nodiscard]]
+inline std::string canonical_form(
+    Camera const& camera,
+    int    const  width,
+    int    const  height)
+{
+    return canonical_record("camera", {
+        camera.position.x, camera.position.y, camera.position.z,
+        camera.forward.x , camera.forward.y , camera.forward.z ,
+        camera.up.x      , camera.up.y      , camera.up.z      ,
+        camera.horizontal_fov,
+        camera.aspect_ratio,
+        camera.shift.x, camera.shift.y,
+    }) + ' ' + std::to_string(width) + 'x' + std::to_string(height);
+}
+
+// 64 bit FNV-1a.
+[[nodiscard]]
+constexpr std::uint64_t content_hash(std::string_view const bytes)
+{
+    std::uint64_t hash = 0xcbf29ce484222325;
+
+    for (char const c : bytes)
+    {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 0x100000001b3;
+    }
+
+    return hash;
+}
+
+/*
+** `settings` describes whatever else changes the pixels, such as which
+** lights implementation shades them and with which parameters, in a
+** form the caller keeps canonical.
+*/
+template <typename Scene> [[nodiscard]]
+RenderKey make_render_key(
+    Scene                   const& scene,
+    MaterialTable           const& materials,
+    std::vector<PointLight> const& lights,
+    Camera                  const& camera,
+    int                     const  width,
+    int                     const  height,
+    std::string_view        const  settings)
+{
+    std::vector<std::string> objects;
+    for (auto const* object : scene_objects(scene))
+        objects.push_back(object->canonical_form() + ' ' + canonical_form(materials[object->material]));
+
+    std::vector<std::string> light_forms;
+    for (auto const& light : lights)
+        light_forms.push_back(canonical_form(light));
+
+    std::ranges::sort(objects);
+    std::ranges::sort(light_forms);
+
+    std::string description = canonical_form(camera, width, height) + '\n';
+
+    for (auto const& form : objects)
+        description += form + '\n';
+    for (auto const& form : light_forms)
+        description += form + '\n';
+
+    description += "settings ";
+    description += settings;
+    description += '\n';
+
+    std::ostringstream name;
+    name << std::hex;
+    name.width(16);
+    name.fill('0');
+    name << content_hash(description);
+
+    return {description, name.str()};
+}
+
+[[nodiscard]]
+inline std::string read_file(std::filesystem::path const& path)
+{
+    std::ifstream input(path, std::ifstream::binary);
+
+    return {std::istreambuf_iterator<char>{input}, std::istreambuf_iterator<char>{}};
+}
+
+/*
+** Copies the cached render for key to output and marks it as just
+** used. Returns false on a miss.
+*/
+[[nodiscard]]
+inline bool restore_cached_render(
+    RenderCache           const& cache,
+    RenderKey             const& key,
+    std::filesystem::path const& output)
+{
+    namespace fs = std::filesystem;
+
+    auto const image       = cache.directory / (key.name + output.extension().string());
+    auto const description = cache.directory / (key.name + ".key");
+
+    std::error_code error;
+
+    if (not fs::exists(image, error) or read_file(description) != key.description)
+        return false;
+
+    fs::copy_file(image, output, fs::copy_options::overwrite_existing, error);
+    if (error)
+        return false;
+
+    fs::last_write_time(image, fs::file_time_type::clock::now(), error);
+
+    return true;
+}
+
+// Removes least recently used entries until the directory fits its limit.
+inline void evict_cached_renders(RenderCache const& cache)
+{
+    namespace fs = std::filesystem;
+
+    struct Entry
+    {
+        fs::file_time_type used  {};
+        std::uintmax_t     bytes {};
+        fs::path           image {};
+    };
+
+    std::map<std::string, Entry> entries;
+    std::uintmax_t               total = 0;
+
+    std::error_code error;
+
+    for (auto const& file : fs::directory_iterator(cache.directory, error))
+    {
+        auto const extension = file.path().extension();
+
+        // Skips files still being written.
+        if (extension == ".tmp")
+            continue;
+
+        auto& entry = entries[file.path().stem().string()];
+
+        auto const bytes = file.file_size(error);
+        if (error)
+            continue;
+
+        entry.bytes += bytes;
+        total       += bytes;
+
+        if (extension != ".key")
+        {
+            entry.used  = file.last_write_time(error);
+            entry.image = file.path();
+        }
+    }
+
+    std::vector<std::pair<std::string, Entry>> by_use(entries.begin(), entries.end());
+
+    std::ranges::sort(by_use, {}, [](auto const& entry) { return entry.second.used; });
+
+    for (auto const& [name, entry] : by_use)
+    {
+        if (total <= cache.max_bytes)
+            break;
+
+        fs::remove(entry.image, error);
+        fs::remove(cache.directory / (name + ".key"), error);
+
+        total -= entry.bytes;
+    }
+}
+
+/*
+** Stores the render at output under key. Files are written under a
+** name of their own and renamed into place, so jobs sharing the
+** directory never see half of a file.
+*/
+inline void store_cached_render(
+    RenderCache           const& cache,
+    RenderKey             const& key,
+    std::filesystem::path const& output)
+{
+    namespace fs = std::filesystem;
+
+    std::error_code error;
+
+    fs::create_directories(cache.directory, error);
+
+    auto const image       = cache.directory / (key.name + output.extension().string());
+    auto const description = cache.directory / (key.name + ".key");
+    auto const temporary   = cache.directory
+                           / (key.name + '.' + std::to_string(std::random_device{}()) + ".tmp");
+
+    {
+        std::ofstream file(temporary, std::ofstream::binary);
+        file << key.description;
+    }
+    fs::rename(temporary, description, error);
+
+    fs::copy_file(output, temporary, fs::copy_options::overwrite_existing, error);
+    if (not error)
+        fs::rename(temporary, image, error);
+
+    if (error)
+    {
+        fs::remove(temporary, error);
+        return;
+    }
+
+    evict_cached_renders(cache);
+}
+
+#endif // RENDERING_RENDER_CACHE_H
@@ -0,0 +1,95 @@
+#ifndef RENDERING_TILED_RENDER_H
+#define RENDERING_TILED_RENDER_H
+
+#include <latch>
+#include <memory>
+#include <vector>
+
+#include <linear_algebra.h>
+#include <objects/object.h>
+#include <output/tiled_image.h>
+#include <rendering/camera.h>
+#include <rendering/render.h>
+#include <scenes/scene_replicas.h>
+#include <threading/thread_pool.h>
+#include <threading/work_stealing_pool.h>
+
+/*
+** Renders a whole frame into a tiled image, a tile per pool task, with
+** the resolution taken from the image at run time. Each thread renders
+** into a buffer of one tile's floats, so memory use is the pool's tile
+** buffers plus the tiles in flight, whatever the size of the frame.
+*/
+template <typename Scene, typename Lights>
+void render_tiled(
+    ThreadPool&          pool,
+    Camera        const& camera,
+    TiledImage&          image,
+    Scene         const& objects,
+    MaterialTable const& materials,
+    Lights        const& lights)
+{
+    auto const rays = make_camera_rays(camera, image.width(), image.height());
+
+    std::latch rendered(image.tile_count());
+
+    for (int k = 0; k < image.tile_count(); ++k)
+    {
+        pool.submit(0, [&, k]
+        {
+            thread_local std::vector<float3> pixels;
+
+            auto const rect = image.tile_rect(k);
+            pixels.resize((rect.x1 - rect.x0) * (rect.y1 - rect.y0));
+
+            render_tile(rays, rect.x0, rect.y0, rect.x1, rect.y1, objects, materials, lights, pixels.data());
+            image.store_tile(k, pixels.data());
+
+            rendered.count_down();
+        });
+    }
+
+    rendered.wait();
+}
+
+/*
+** The same on a work stealing pool, with the scene replicated per NUMA
+** node. The image is split into a contiguous band of tiles per node, so
+** a node's workers write, and first touch, their own part of the mapped
+** file, and every tile is traced against the replica of the node of
+** the worker that ends up rendering it, stolen or not.
+*/
+inline void render_tiled(
+    WorkStealingPool&                                 pool,
+    Camera                                     const& camera,
+    TiledImage&                                       image,
+    std::vector<std::unique_ptr<SceneReplica>> const& replicas)
+{
+    auto const rays = make_camera_rays(camera, image.width(), image.height());
+
+    std::latch rendered(image.tile_count());
+
+    for (int k = 0; k < image.tile_count(); ++k)
+    {
+        int const node = static_cast<int>(static_cast<long long>(k) * pool.node_count() / image.tile_count());
+
+        pool.submit([&, k]
+        {
+            thread_local std::vector<float3> pixels;
+
+            auto const& [scene, lights] = *replicas[WorkStealingPool::current_node()];
+
+            auto const rect = image.tile_rect(k);
+            pixels.resize((rect.x1 - rect.x0) * (rect.y1 - rect.y0));
+
+            render_tile(rays, rect.x0, rect.y0, rect.x1, rect.y1, scene.objects, scene.materials, lights, pixels.data());
+            image.store_tile(k, pixels.data());
+
+            rendered.count_down();
+        }, node);
+    }
+
+    rendered.wait();
+}
+
+#endif // RENDERING_TILED_RENDER_H
@@ -0,0 +1,395 @@
+#ifndef SAMPLING_SAMPLER_H
+#define SAMPLING_SAMPLER_H
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+
+#include <linear_algebra.h>
+
+/*
+** Sample sequences for Monte Carlo estimates over a pixel.
+**
+** Every value is a pure function of (pixel, sample index, dimension,
+** seed), so images don't depend on the order tiles or rows were handed
+** to threads. A PixelSampler only counts dimensions: each feature asks
+** for its values in a fixed order, and the n-th value it gets is always
+** dimension n of the same sample.
+**
+**      independent       hashed white noise, the baseline;
+**      halton            radical inverses in the first 32 prime bases,
+**                        digits scrambled per pixel;
+**      sobol             Owen scrambled (0, 2)-sequence, padded: every
+**                        pair of dimensions gets its own scramble and
+**                        sample order, scrambled per pixel;
+**      blue_noise_sobol  the same sequence, but shared by all pixels and
+**                        handed out along a scrambled Morton curve, so
+**                        that neighbouring pixels get complementary
+**                        samples and the remaining error is blue noise
+**                        (Ahmed and Wonka 2020, as in pbrt-v4's
+**                        ZSobolSampler).
+**
+** The Sobol sequences are only fully stratified for power of two sample
+** counts.
+*/
+enum class SampleSequence
+{
+    independent,
+    halton,
+    sobol,
+    blue_noise_sobol,
+};
+
+struct Sampler
+{
+    SampleSequence sequence          = SampleSequence::blue_noise_sobol;
+    int            samples_per_pixel = 16;
+    std::uint32_t  seed              = 0;
+    // Only needed to lay the Morton curve over the image.
+    int            width             = 1920;
+    int            height            = 1080;
+};
+
+[[nodiscard]]
+constexpr std::uint64_t mix_bits(std::uint64_t v) noexcept
+{
+    // The splitmix64 finalizer.
+    v ^= v >> 31;
+    v *= 0x7fb5d329728ea185ull;
+    v ^= v >> 27;
+    v *= 0x81dadef4bc2dd44dull;
+    v ^= v >> 33;
+    return v;
+}
+
+[[nodiscard]]
+constexpr std::uint64_t hash_sample(
+    std::uint64_t const a,
+    std::uint64_t const b) noexcept
+{
+    return mix_bits(mix_bits(a) + b);
+}
+
+[[nodiscard]]
+constexpr std::uint32_t reverse_bits(std::uint32_t v) noexcept
+{
+    v = (v << 16) | (v >> 16);
+    v = ((v & 0x00ff00ffu) << 8) | ((v & 0xff00ff00u) >> 8);
+    v = ((v & 0x0f0f0f0fu) << 4) | ((v & 0xf0f0f0f0u) >> 4);
+    v = ((v & 0x33333333u) << 2) | ((v & 0xccccccccu) >> 2);
+    v = ((v & 0x55555555u) << 1) | ((v & 0xaaaaaaaau) >> 1);
+    return v;
+}
+
+/*
+** Nested uniform (Owen) scrambling of a 32 bit fixed point value: every
+** bit is flipped depending on the bits above it, which keeps all the
+** stratification of the sequence while decorrelating it. This is the
+** hash based approximation of Laine and Karras, as refined by
+** Burley and in pbrt-v4; it works on the reversed bits, where "above"
+** becomes "below" and a multiply propagates in the right direction.
+*/
+[[nodiscard]]
+constexpr std::uint32_t owen_scramble(
+    std::uint32_t       v,
+    std::uint32_t const seed) noexcept
+{
+    v = reverse_bits(v);
+    v ^= v * 0x3d20adeau;
+    v += seed;
+    v *= (seed >> 16) | 1;
+    v ^= v * 0x05526c56u;
+    v ^= v * 0x53a22864u;
+    return reverse_bits(v);
+}
+
+// Fixed point in [0, 1) to the largest float below 1 at most.
+[[nodiscard]]
+constexpr float to_unit_float(std::uint32_t const v) noexcept
+{
+    return std::min(static_cast<float>(v) * 0x1p-32f, 0x1.fffffep-1f);
+}
+
+/*
+** Generator matrix columns of the second Sobol dimension, from the
+** primitive polynomial x + 1: v_0 = 1/2 and v_k = v_{k-1} ^ v_{k-1}/2.
+** The first dimension is the van der Corput sequence, whose columns are
+** the plain bit reversal.
+*/
+constexpr auto sobol_dimension_1 = []
+{
+    std::array<std::uint32_t, 32> v {};
+    v[0] = 1u << 31;
+
+    for (int k = 1; k < 32; ++k)
+        v[k] = v[k - 1] ^ (v[k - 1] >> 1);
+
+    return v;
+}();
+
+struct SobolPoint
+{
+    std::uint32_t x {};
+    std::uint32_t y {};
+};
+
+[[nodiscard]]
+constexpr SobolPoint sobol_2d(std::uint32_t index) noexcept
+{
+    SobolPoint point {reverse_bits(index), 0};
+
+    for (int k = 0; index != 0; index >>= 1, ++k)
+    {
+        if (index & 1)
+            point.y ^= sobol_dimension_1[k];
+    }
+
+    return point;
+}
+
+// Point `index` of the (0, 2)-sequence, each dimension Owen scrambled
+// by its own seed.
+[[nodiscard]]
+constexpr float2 scrambled_sobol_2d(
+    std::uint32_t const index,
+    std::uint32_t const seed_x,
+    std::uint32_t const seed_y) noexcept
+{
+    auto const point = sobol_2d(index);
+
+    return {
+        to_unit_float(owen_scramble(point.x, seed_x)),
+        to_unit_float(owen_scramble(point.y, seed_y)),
+    };
+}
+
+// The same, with the dimensions scrambled by the low and the high half
+// of one seed.
+[[nodiscard]]
+constexpr float2 scrambled_sobol_2d(
+    std::uint32_t const index,
+    std::uint64_t const seed) noexcept
+{
+    return scrambled_sobol_2d(index, static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32));
+}
+
+constexpr std::array<std::uint32_t, 32> halton_bases = {
+      2,   3,   5,   7,  11,  13,  17,  19,  23,  29,  31,  37,  41,  43,  47,  53,
+     59,  61,  67,  71,  73,  79,  83,  89,  97, 101, 103, 107, 109, 113, 127, 131,
+};
+
+/*
+** Radical inverse of the index in the given base, with every digit
+** rotated by its own amount derived from the seed. The rotations are
+** the same for every index, so the sequence keeps its stratification.
+*/
+[[nodiscard]]
+constexpr float scrambled_radical_inverse(
+    std::uint32_t const base,
+    std::uint32_t       index,
+    std::uint64_t const seed) noexcept
+{
+    float const inverse_base = 1.f / static_cast<float>(base);
+
+    std::uint32_t reversed = 0;
+    float         scale    = 1;
+
+    // Digits of the (implicitly zero padded) index until the value
+    // stops changing in single precision.
+    for (std::uint64_t level = 0; scale * inverse_base > 0x1p-24f; ++level)
+    {
+        std::uint32_t const rotation
+            = static_cast<std::uint32_t>(mix_bits(seed + level * 0x9e3779b97f4a7c15ull) % base);
+        std::uint32_t const digit    = (index % base + rotation) % base;
+
+        reversed  = reversed * base + digit;
+        scale    *= inverse_base;
+        index    /= base;
+    }
+
+    return std::min(static_cast<float>(reversed) * scale, 0x1.fffffep-1f);
+}
+
+[[nodiscard]]
+constexpr int ceil_log2(std::uint32_t const v) noexcept
+{
+    return v <= 1 ? 0 : std::bit_width(v - 1);
+}
+
+[[nodiscard]]
+constexpr std::uint64_t morton_2d(std::uint32_t const x, std::uint32_t const y) noexcept
+{
+    auto const spread = [](std::uint64_t v)
+    {
+        v &= 0xffffffffull;
+        v = (v | (v << 16)) & 0x0000ffff0000ffffull;
+        v = (v | (v <<  8)) & 0x00ff00ff00ff00ffull;
+        v = (v | (v <<  4)) & 0x0f0f0f0f0f0f0f0full;
+        v = (v | (v <<  2)) & 0x3333333333333333ull;
+        v = (v | (v <<  1)) & 0x5555555555555555ull;
+        return v;
+    };
+
+    return spread(x) | (spread(y) << 1);
+}
+
+/*
+** Index into the shared Sobol sequence for a pixel's sample along one
+** pair of dimensions. Pixels are ordered along the Morton curve with
+** their samples consecutive, so every aligned block of 4^k indices is a
+** square of pixels; the (0, 2)-sequence stratifies exactly such blocks.
+** To hide the curve, every base 4 digit is permuted by one of the 24
+** permutations, picked by hashing the digits above it and the
+** dimension.
+*/
+[[nodiscard]]
+inline std::uint32_t blue_noise_sample_index(
+    Sampler       const& sampler,
+    std::uint32_t const  x,
+    std::uint32_t const  y,
+    std::uint32_t const  sample,
+    std::uint32_t const  dimension)
+{
+    static constexpr std::uint8_t permutations[24][4] = {
+        {0, 1, 2, 3}, {0, 1, 3, 2}, {0, 2, 1, 3}, {0, 2, 3, 1}, {0, 3, 2, 1}, {0, 3, 1, 2},
+        {1, 0, 2, 3}, {1, 0, 3, 2}, {1, 2, 0, 3}, {1, 2, 3, 0}, {1, 3, 2, 0}, {1, 3, 0, 2},
+        {2, 1, 0, 3}, {2, 1, 3, 0}, {2, 0, 1, 3}, {2, 0, 3, 1}, {2, 3, 0, 1}, {2, 3, 1, 0},
+        {3, 1, 2, 0}, {3, 1, 0, 2}, {3, 2, 1, 0}, {3, 2, 0, 1}, {3, 0, 2, 1}, {3, 0, 1, 2},
+    };
+
+    int const log2_samples    = ceil_log2(static_cast<std::uint32_t>(sampler.samples_per_pixel));
+    int const log2_resolution = ceil_log2(static_cast<std::uint32_t>(std::max(sampler.width, sampler.height)));
+
+    // The Sobol generator has 32 columns.
+    assert(2 * log2_resolution + log2_samples <= 32);
+
+    std::uint64_t const morton = (morton_2d(x, y) << log2_samples) | sample;
+    std::uint64_t const salt   = 0x55555555ull * dimension ^ sampler.seed;
+
+    // With an odd number of sample bits, the lowest digit is base 2.
+    bool const odd    = log2_samples & 1;
+    int  const digits = log2_resolution + (log2_samples + 1) / 2;
+
+    std::uint64_t index = 0;
+
+    for (int i = digits - 1; i >= (odd ? 1 : 0); --i)
+    {
+        int           const shift  = 2 * i - (odd ? 1 : 0);
+        std::uint64_t const digit  = (morton >> shift) & 3;
+        std::uint64_t const higher = morton >> (shift + 2);
+
+        auto const permutation = (mix_bits(higher ^ salt) >> 24) % 24;
+
+        index |= std::uint64_t{permutations[permutation][digit]} << shift;
+    }
+
+    if (odd)
+        index |= (morton & 1) ^ (mix_bits((morton >> 1) ^ salt) & 1);
+
+    return static_cast<std::uint32_t>(index);
+}
+
+/*
+** Values for one sample of one pixel, handed out dimension by dimension.
+*/
+struct PixelSampler
+{
+    Sampler const* sampler    {};
+    std::uint32_t  x          {};
+    std::uint32_t  y          {};
+    std::uint32_t  sample     {};
+    std::uint32_t  dimension  {};
+    std::uint64_t  pixel_seed {};
+
+    [[nodiscard]]
+    float next_1d()
+    {
+        return next_2d().x;
+    }
+
+    [[nodiscard]]
+    float2 next_2d()
+    {
+        std::uint32_t const d = dimension;
+        dimension += 2;
+
+        switch (sampler->sequence)
+        {
+            case SampleSequence::independent:
+            {
+                std::uint64_t const bits = hash_sample(hash_sample(pixel_seed, sample), d);
+
+                return {
+                    to_unit_float(static_cast<std::uint32_t>(bits)),
+                    to_unit_float(static_cast<std::uint32_t>(bits >> 32)),
+                };
+            }
+
+            case SampleSequence::halton:
+            {
+                // Past the last prime there is nothing left to stratify.
+                if (d + 1 >= halton_bases.size())
+                {
+                    std::uint64_t const bits = hash_sample(hash_sample(pixel_seed, sample), d);
+
+                    return {
+                        to_unit_float(static_cast<std::uint32_t>(bits)),
+                        to_unit_float(static_cast<std::uint32_t>(bits >> 32)),
+                    };
+                }
+
+                return {
+                    scrambled_radical_inverse(halton_bases[d    ], sample, hash_sample(pixel_seed, d    )),
+                    scrambled_radical_inverse(halton_bases[d + 1], sample, hash_sample(pixel_seed, d + 1)),
+                };
+            }
+
+            case SampleSequence::sobol:
+            {
+                // Shuffle the samples separately for every pair of
+                // dimensions, so the pairs don't correlate. Owen
+                // scrambling the top bits permutes [0, 2^k).
+                std::uint64_t const seed = hash_sample(pixel_seed, d);
+                int const bits = ceil_log2(static_cast<std::uint32_t>(sampler->samples_per_pixel));
+
+                std::uint32_t const index = bits == 0 ? 0
+                    : owen_scramble(sample << (32 - bits), static_cast<std::uint32_t>(seed)) >> (32 - bits);
+
+                return scrambled_sobol_2d(
+                    index, static_cast<std::uint32_t>(seed >> 32), static_cast<std::uint32_t>(mix_bits(seed))
+                );
+            }
+
+            case SampleSequence::blue_noise_sobol:
+            default:
+            {
+                std::uint64_t const seed = hash_sample(sampler->seed, d);
+
+                return scrambled_sobol_2d(
+                    blue_noise_sample_index(*sampler, x, y, sample, d), seed
+                );
+            }
+        }
+    }
+};
+
+[[nodiscard]]
+inline PixelSampler start_pixel_sample(
+    Sampler const& sampler,
+    int     const  x,
+    int     const  y,
+    int     const  sample)
+{
+    return {
+        .sampler    = &sampler,
+        .x          = static_cast<std::uint32_t>(x),
+        .y          = static_cast<std::uint32_t>(y),
+        .sample     = static_cast<std::uint32_t>(sample),
+        .dimension  = 0,
+        .pixel_seed = hash_sample(hash_sample(sampler.seed, static_cast<std::uint64_t>(x)), static_cast<std::uint64_t>(y)),
+    };
+}
+
+#endif // SAMPLING_SAMPLER_H
@@ -0,0 +1,155 @@
+#ifndef SCENES_SCENE_FILE_H
+#define SCENES_SCENE_FILE_H
+
+#include <istream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <linear_algebra.h>
+#include <objects/object.h>
+#include <objects/sphere.h>
+#include <objects/cylinder.h>
+#include <objects/cuboid.h>
+#include <lights/point_light.h>
+
+/*
+** Scenes described in text, one statement per line:
+**
+**      material <name> <r> <g> <b> <diffuse> <specular> <exponent> <reflectivity>
+**      sphere   <material> <x> <y> <z> <radius>
+**      cylinder <material> <x> <y> <z> <radius> <height>
+**      cuboid   <material> <x1> <y1> <z1> <x2> <y2> <z2>
+**      light    <x> <y> <z> <intensity>
+**
+** Materials have to be declared before primitives use them. Blank
+** lines and everything after a '#' are ignored.
+*/
+struct SceneFile
+{
+    MaterialTable                        materials  {};
+    std::vector<std::unique_ptr<Object>> primitives {};
+    // The primitives again, as the scene the renderer takes.
+    std::vector<Object const*>           objects    {};
+    std::vector<PointLight>              lights     {};
+};
+
+// Thrown with the line it failed on for text that isn't a valid scene.
+struct SceneParseError : std::runtime_error
+{
+    using std::runtime_error::runtime_error;
+};
+
+[[nodiscard]]
+inline SceneFile parse_scene(std::istream& input)
+{
+    SceneFile scene;
+
+    std::map<std::string, MaterialIndex> material_names;
+
+    std::string line;
+
+    for (int number = 1; std::getline(input, line); ++number)
+    {
+        line = line.substr(0, line.find('#'));
+
+        std::istringstream statement(line);
+        std::string        kind;
+
+        if (not (statement >> kind))
+            continue;
+
+        auto const fail = [&](std::string const& message)
+        {
+            return SceneParseError("line " + std::to_string(number) + ": " + message);
+        };
+
+        auto const read_material = [&]
+        {
+            std::string name;
+            statement >> name;
+
+            auto const found = material_names.find(name);
+            if (found == material_names.end())
+                throw fail("unknown material '" + name + "'");
+
+            return found->second;
+        };
+
+        auto const read_float3 = [&]
+        {
+            float3 v;
+            statement >> v.x >> v.y >> v.z;
+            return v;
+        };
+
+        if (kind == "material")
+        {
+            std::string name;
+            Material    material;
+
+            statement >> name >> material.diffuse_color.x
+                              >> material.diffuse_color.y
+                              >> material.diffuse_color.z
+                              >> material.diffuse_coefficient
+                              >> material.specular_coefficient
+                              >> material.specular_exponent
+                              >> material.reflectivity;
+
+            material_names[name] = static_cast<MaterialIndex>(scene.materials.size());
+            scene.materials.push_back(material);
+        }
+        else if (kind == "sphere")
+        {
+            auto const material = read_material();
+            auto const center   = read_float3();
+            float      radius   = 0;
+            statement >> radius;
+
+            scene.primitives.push_back(std::make_unique<Sphere>(material, center, radius));
+        }
+        else if (kind == "cylinder")
+        {
+            auto const material = read_material();
+            auto const center   = read_float3();
+            float      radius   = 0;
+            float      height   = 0;
+            statement >> radius >> height;
+
+            scene.primitives.push_back(std::make_unique<Cylinder>(material, center, radius, height));
+        }
+        else if (kind == "cuboid")
+        {
+            auto const material = read_material();
+            auto const v1       = read_float3();
+            auto const v2       = read_float3();
+
+            scene.primitives.push_back(std::make_unique<Cuboid>(material, v1, v2));
+        }
+        else if (kind == "light")
+        {
+            PointLight light;
+            light.position = read_float3();
+            statement >> light.intensity;
+
+            scene.lights.push_back(light);
+        }
+        else
+        {
+            throw fail("unknown statement '" + kind + "'");
+        }
+
+        if (statement.fail())
+            throw fail("expected more numbers after '" + kind + "'");
+    }
+
+    for (auto const& primitive : scene.primitives)
+        scene.objects.push_back(primitive.get());
+
+    return scene;
+}
+
+#endif // SCENES_SCENE_FILE_H
@@ -0,0 +1,50 @@
+#ifndef SCENES_SCENE_REPLICAS_H
+#define SCENES_SCENE_REPLICAS_H
+
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <lights/shadow_culled_lights.h>
+#include <scenes/scene_file.h>
+#include <threading/work_stealing_pool.h>
+
+/*
+** A copy of the scene per NUMA node, so tracing reads primitives,
+** materials and shadow caster lists from its own node's memory rather
+** than from wherever the scene happened to be loaded.
+**
+** Each copy is parsed and built by a thread on its node, which makes
+** that node's memory the one its pages are first written to, and so the
+** one they stay in.
+*/
+struct SceneReplica
+{
+    SceneFile          scene  {};
+    ShadowCulledLights lights {};
+};
+
+// The scene in text, once for every node of pool, by node.
+[[nodiscard]]
+inline std::vector<std::unique_ptr<SceneReplica>> replicate_scene(
+    WorkStealingPool&        pool,
+    std::string       const& text)
+{
+    std::vector<std::unique_ptr<SceneReplica>> replicas(pool.node_count());
+
+    pool.run_on_each_node([&](int const node)
+    {
+        std::istringstream input(text);
+
+        auto replica    = std::make_unique<SceneReplica>();
+        replica->scene  = parse_scene(input);
+        replica->lights = build_shadow_culled_lights(replica->scene.lights, replica->scene.objects);
+
+        replicas[node] = std::move(replica);
+    });
+
+    return replicas;
+}
+
+#endif // SCENES_SCENE_REPLICAS_H
@@ -0,0 +1,69 @@
+#ifndef SCENES_STATIC_SCENE_H
+#define SCENES_STATIC_SCENE_H
+
+#include <tuple>
+#include <vector>
+
+#include <linear_algebra.h>
+#include <objects/object.h>
+#include <rays/ray.h>
+
+/*
+** A scene whose set of primitives is fixed at compile time.
+**
+** Unlike the std::vector<Object const*> scene, every primitive is
+** stored by value with its concrete type, so the nearest-hit loop
+** below is unrolled over the tuple and every intersection test is
+** a direct, inlinable call instead of a virtual one. shade() and
+** trace<>() pick this overload up through argument dependent lookup.
+*/
+template <typename... Objects>
+struct StaticScene
+{
+    std::tuple<Objects...> objects;
+
+    constexpr explicit StaticScene(Objects const&... objects)
+        : objects{objects...}
+    {}
+};
+
+template <typename... Objects> [[nodiscard]]
+constexpr Object::RayIntersectionData get_nearest_ray_intersection_data(
+    Ray                     const  ray,
+    StaticScene<Objects...> const& scene)
+{
+    auto nearest_intersection_data = Object::RayIntersectionData
+    {
+        .intersected_object    = nullptr,
+        .intersection_distance = 20000,
+        .intersection_point    = {},
+        .intersection_normal   = {},
+    };
+
+    auto const test = [&]<typename T>(T const& object)
+    {
+        // Qualified call, so no virtual dispatch even without `final`.
+        auto const data = object.T::get_ray_intersection_data(ray);
+        auto const d    = data.intersection_distance;
+
+        if (0 < d and d < nearest_intersection_data.intersection_distance)
+        {
+            nearest_intersection_data = data;
+        }
+    };
+
+    std::apply([&](auto const&... object) { (test(object), ...); }, scene.objects);
+
+    return nearest_intersection_data;
+}
+
+template <typename... Objects> [[nodiscard]]
+std::vector<Object const*> scene_objects(StaticScene<Objects...> const& scene)
+{
+    return std::apply(
+        [](auto const&... object) { return std::vector<Object const*>{&object...}; },
+        scene.objects
+    );
+}
+
+#endif // SCENES_STATIC_SCENE_H
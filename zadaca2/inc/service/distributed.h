@@ -0,0 +1,398 @@
+#ifndef SERVICE_DISTRIBUTED_H
+#define SERVICE_DISTRIBUTED_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include <linear_algebra.h>
+#include <lights/shadow_culled_lights.h>
+#include <rendering/camera.h>
+#include <rendering/render.h>
+#include <scenes/scene_file.h>
+#include <service/render_protocol.h>
+#include <service/unix_socket.h>
+
+/*
+** One frame rendered by several worker processes.
+**
+** Workers connect to the coordinator's socket and are sent the job
+** once, as a render request carrying the scene. After that the
+** coordinator hands out tiles, a few at a time per worker so none of
+** them waits on the round trip, and copies the finished tiles into the
+** frame:
+**
+**      coordinator: tile <index> <x0> <y0> <x1> <y1>
+**      worker:      done <index>, then the tile's pixels
+**      coordinator: exit                 (once every tile is in)
+**
+** Tiles go to whichever worker asks next, so fast and slow workers
+** both stay busy. A worker that disconnects, crashes or sends garbage
+** has the tiles it was holding put back at the front of the queue for
+** the others, and so does one that stays connected but doesn't send a
+** tile back within the tile timeout of handing it out; it is
+** disconnected. Workers may join at any point while the frame is being
+** rendered.
+*/
+struct DistributedSettings
+{
+    int tile_size       = 64;
+    // Tiles each worker holds at once.
+    int tiles_in_flight = 2;
+    // Give up once no worker has been connected for this long.
+    std::chrono::milliseconds worker_timeout {10000};
+    // Drop a worker that takes longer than this to return a tile.
+    std::chrono::milliseconds tile_timeout   {30000};
+};
+
+struct DistributedStats
+{
+    int    workers  {};
+    int    tiles    {};
+    int    reissued {};
+    double ms       {};
+};
+
+/*
+** Renders tiles for the coordinator at path until it says to stop.
+** fail_after > 0 drops the connection after that many tiles, with more
+** already handed out, which is how a dying worker looks to the
+** coordinator. hang_after > 0 instead stops answering after that many
+** tiles but stays connected, like a worker that is stuck.
+*/
+inline void run_render_worker(
+    std::string const& path,
+    int         const  fail_after = 0,
+    int         const  hang_after = 0)
+{
+    auto const   connection = connect_unix(path);
+    SocketReader reader(connection);
+
+    auto const job = read_request(reader);
+    if (not job or not job->scene)
+        throw ProtocolError("expected the job with its scene");
+
+    std::istringstream text(*job->scene);
+
+    auto const scene  = parse_scene(text);
+    auto const lights = build_shadow_culled_lights(scene.lights, scene.objects);
+    auto const rays   = make_camera_rays(job->camera, job->width, job->height);
+
+    std::vector<float3> pixels;
+    std::string         reply;
+
+    for (int rendered = 0; ; ++rendered)
+    {
+        if (fail_after > 0 and rendered == fail_after)
+            return;
+
+        if (hang_after > 0 and rendered == hang_after)
+        {
+            // Until the coordinator gives up on us.
+            while (reader.read_line())
+            {}
+
+            return;
+        }
+
+        auto const line = reader.read_line();
+        if (not line or *line == "exit")
+            return;
+
+        std::istringstream message(*line);
+        std::string        word;
+        int index, x0, y0, x1, y1;
+
+        message >> word >> index >> x0 >> y0 >> x1 >> y1;
+
+        if (message.fail() or word != "tile"
+            or x0 < 0 or y0 < 0 or x1 > job->width or y1 > job->height or x0 >= x1 or y0 >= y1)
+            throw ProtocolError("bad tile '" + *line + "'");
+
+        pixels.resize((x1 - x0) * (y1 - y0));
+        render_tile(rays, x0, y0, x1, y1, scene.objects, scene.materials, lights, pixels.data());
+
+        reply = "done " + std::to_string(index) + '\n';
+
+        auto const header = reply.size();
+        reply.resize(header + 3 * pixels.size());
+        to_pixel_bytes(pixels.data(), pixels.size(), reply.data() + header);
+
+        if (not write_all(connection, reply))
+            return;
+    }
+}
+
+/*
+** Starts count copies of executable as workers of the coordinator at
+** path, and returns their process ids.
+*/
+[[nodiscard]]
+inline std::vector<pid_t> spawn_render_workers(
+    std::string const& executable,
+    std::string const& path,
+    int         const  count)
+{
+    std::vector<pid_t> workers;
+
+    std::string worker_argument = "--worker=" + path;
+
+    for (int k = 0; k < count; ++k)
+    {
+        char* arguments[] = {
+            const_cast<char*>(executable.c_str()),
+            worker_argument.data(),
+            nullptr,
+        };
+
+        pid_t pid;
+        if (::posix_spawn(&pid, executable.c_str(), nullptr, nullptr, arguments, environ) == 0)
+            workers.push_back(pid);
+    }
+
+    return workers;
+}
+
+/*
+** Renders job (which has to carry its scene) on whatever workers
+** connect to listener, and returns the frame as 8 bit RGB rows. Throws
+** if every worker is gone for longer than the timeout before the frame
+** is done, and std::invalid_argument for a tile size or tiles in flight
+** that aren't positive.
+*/
+[[nodiscard]]
+inline std::string render_distributed(
+    Socket              const& listener,
+    RenderRequest       const& job,
+    DistributedSettings const  settings = {},
+    DistributedStats*   const  stats    = nullptr)
+{
+    struct Tile
+    {
+        int x0, y0, x1, y1;
+    };
+
+    if (settings.tile_size <= 0 or settings.tiles_in_flight <= 0)
+        throw std::invalid_argument("distributed render needs a positive tile size and tiles in flight");
+
+    auto const start = std::chrono::steady_clock::now();
+
+    std::vector<Tile> tiles;
+
+    for (int y = 0; y < job.height; y += settings.tile_size)
+    {
+        for (int x = 0; x < job.width; x += settings.tile_size)
+        {
+            tiles.push_back({
+                x, y,
+                std::min(x + settings.tile_size, job.width),
+                std::min(y + settings.tile_size, job.height),
+            });
+        }
+    }
+
+    std::string frame(3ull * job.width * job.height, '\0');
+
+    std::mutex              mutex;
+    std::condition_variable changed;
+    std::deque<int>         pending;
+    std::vector<char>       done(tiles.size(), 0);
+    std::size_t             completed = 0;
+    int                     alive     = 0;
+    int                     workers   = 0;
+    int                     reissued  = 0;
+
+    for (int k = 0; k < static_cast<int>(tiles.size()); ++k)
+        pending.push_back(k);
+
+    auto const finished = [&] { return completed == tiles.size(); };
+
+    std::string const setup = format_request(job);
+
+    auto const serve_worker = [&](Socket const connection)
+    {
+        using clock = std::chrono::steady_clock;
+
+        // A tile the worker was sent, and when it has to be back.
+        struct HeldTile
+        {
+            int               index    {};
+            clock::time_point deadline {};
+        };
+
+        SocketReader         reader(connection);
+        std::deque<HeldTile> held;
+
+        // Hands back whatever the worker was holding, if it died.
+        auto const drop = [&]
+        {
+            std::lock_guard const lock(mutex);
+
+            for (auto k = held.rbegin(); k != held.rend(); ++k)
+                pending.push_front(k->index);
+
+            reissued += static_cast<int>(held.size());
+            --alive;
+
+            changed.notify_all();
+        };
+
+        if (not write_all(connection, setup))
+            return drop();
+
+        while (true)
+        {
+            std::string messages;
+
+            {
+                std::unique_lock lock(mutex);
+
+                changed.wait(lock, [&]
+                {
+                    return finished() or not held.empty() or not pending.empty();
+                });
+
+                if (finished())
+                    break;
+
+                while (static_cast<int>(held.size()) < settings.tiles_in_flight and not pending.empty())
+                {
+                    int  const k    = pending.front();
+                    auto const tile = tiles[k];
+                    pending.pop_front();
+                    held.push_back({k, clock::now() + settings.tile_timeout});
+
+                    messages += "tile " + std::to_string(k)       + ' '
+                              + std::to_string(tile.x0) + ' ' + std::to_string(tile.y0) + ' '
+                              + std::to_string(tile.x1) + ' ' + std::to_string(tile.y1) + '\n';
+                }
+            }
+
+            if (not write_all(connection, messages))
+                return drop();
+
+            // Tiles come back in the order they were sent, so the first
+            // one held is the next due; a worker that misses its deadline
+            // is treated as gone.
+            reader.set_deadline(held.front().deadline);
+
+            auto const line = reader.read_line();
+
+            int k = -1;
+            if (line and line->starts_with("done "))
+                k = std::atoi(line->c_str() + 5);
+
+            auto const held_tile = std::find_if(held.begin(), held.end(), [&](HeldTile const& tile)
+            {
+                return tile.index == k;
+            });
+
+            if (held_tile == held.end())
+                return drop();
+
+            auto const  tile   = tiles[k];
+            int  const  width  = tile.x1 - tile.x0;
+            auto const  pixels = reader.read_bytes(3ull * width * (tile.y1 - tile.y0));
+
+            if (not pixels)
+                return drop();
+
+            for (int y = tile.y0; y < tile.y1; ++y)
+            {
+                std::copy_n(
+                    pixels->data() + 3ull * (y - tile.y0) * width, 3ull * width,
+                    frame.data() + 3ull * (y * job.width + tile.x0)
+                );
+            }
+
+            std::lock_guard const lock(mutex);
+
+            held.erase(held_tile);
+
+            if (not done[k])
+            {
+                done[k] = 1;
+                ++completed;
+            }
+
+            changed.notify_all();
+        }
+
+        (void) write_all(connection, "exit\n");
+
+        std::lock_guard const lock(mutex);
+        --alive;
+        changed.notify_all();
+    };
+
+    std::vector<std::jthread> connections;
+    auto last_alive = std::chrono::steady_clock::now();
+
+    while (true)
+    {
+        {
+            std::unique_lock lock(mutex);
+
+            if (finished())
+                break;
+
+            if (alive > 0)
+                last_alive = std::chrono::steady_clock::now();
+            else if (std::chrono::steady_clock::now() - last_alive > settings.worker_timeout)
+                throw std::runtime_error("no workers left to render the frame");
+        }
+
+        pollfd incoming {listener.fd(), POLLIN, 0};
+
+        if (::poll(&incoming, 1, 50) == 1)
+        {
+            int const fd = ::accept(listener.fd(), nullptr, nullptr);
+
+            if (fd >= 0)
+            {
+                {
+                    std::lock_guard const lock(mutex);
+                    ++alive;
+                    ++workers;
+                }
+
+                connections.emplace_back(serve_worker, Socket(fd));
+            }
+        }
+    }
+
+    // Workers still waiting for tiles see that the frame is done and say
+    // goodbye; the threads are joined as they go out of scope.
+    changed.notify_all();
+    connections.clear();
+
+    if (stats)
+    {
+        *stats = {
+            .workers  = workers,
+            .tiles    = static_cast<int>(tiles.size()),
+            .reissued = reissued,
+            .ms       = std::chrono::duration<double, std::milli>(
+                            std::chrono::steady_clock::now() - start
+                        ).count(),
+        };
+    }
+
+    return frame;
+}
+
+#endif // SERVICE_DISTRIBUTED_H
@@ -0,0 +1,199 @@
+#ifndef SERVICE_RENDER_PROTOCOL_H
+#define SERVICE_RENDER_PROTOCOL_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <ios>
+#include <numbers>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <linear_algebra.h>
+#include <rendering/camera.h>
+#include <service/unix_socket.h>
+
+/*
+** What the render server and its clients say to each other. A request
+** is a few lines of text:
+**
+**      render <scene id> <width> <height> <priority>
+**      camera <position> <forward> <up> <horizontal fov> <shift x> <shift y>
+**      scene <byte count>                  (optional)
+**      <the scene file, byte count bytes>
+**      end
+**
+** The scene is only needed the first time an id is used, or to change
+** what it refers to; after that the server keeps it loaded. Jobs with a
+** higher priority are rendered first.
+**
+** The reply is either the image as a binary PPM, streamed as rows are
+** finished, or a single "error <message>" line. A connection can carry
+** any number of requests, one after another.
+*/
+struct RenderRequest
+{
+    std::string                scene_id {};
+    int                        width    {};
+    int                        height   {};
+    int                        priority {};
+    Camera                     camera   {};
+    std::optional<std::string> scene    {};
+};
+
+constexpr std::size_t max_scene_bytes  = 64 << 20;
+// Up to 16384 on a side, and 32 megapixels, 8K UHD with room to spare,
+// in all: the whole image is held in memory while it is sent.
+constexpr int         max_image_side   = 16384;
+constexpr long long   max_image_pixels = 1 << 25;
+
+// A request that doesn't follow the protocol.
+struct ProtocolError : std::runtime_error
+{
+    using std::runtime_error::runtime_error;
+};
+
+[[nodiscard]]
+inline std::string format_request(RenderRequest const& request)
+{
+    auto const& c = request.camera;
+
+    std::ostringstream text;
+    text << std::hexfloat
+         << "render " << request.scene_id << ' '
+                      << request.width    << ' '
+                      << request.height   << ' '
+                      << request.priority << '\n'
+         << "camera " << c.position.x << ' ' << c.position.y << ' ' << c.position.z << ' '
+                      << c.forward.x  << ' ' << c.forward.y  << ' ' << c.forward.z  << ' '
+                      << c.up.x       << ' ' << c.up.y       << ' ' << c.up.z       << ' '
+                      << c.horizontal_fov << ' '
+                      << c.shift.x    << ' ' << c.shift.y    << '\n';
+
+    if (request.scene)
+        text << "scene " << request.scene->size() << '\n' << *request.scene;
+
+    text << "end\n";
+
+    return text.str();
+}
+
+// Pixels as they go over the wire: 8 bit RGB, truncated like main's PPM.
+inline void to_pixel_bytes(
+    float3 const* const pixels,
+    std::size_t   const count,
+    char*               out)
+{
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        *out++ = static_cast<char>(static_cast<unsigned char>(pixels[i].x));
+        *out++ = static_cast<char>(static_cast<unsigned char>(pixels[i].y));
+        *out++ = static_cast<char>(static_cast<unsigned char>(pixels[i].z));
+    }
+}
+
+/*
+** The next request on the connection, or nothing once the client has
+** closed it. Throws ProtocolError for anything malformed.
+*/
+[[nodiscard]]
+inline std::optional<RenderRequest> read_request(SocketReader& reader)
+{
+    auto line = reader.read_line();
+    if (not line)
+        return std::nullopt;
+
+    RenderRequest request;
+
+    std::string word;
+
+    std::istringstream header(*line);
+    header >> word >> request.scene_id >> request.width >> request.height >> request.priority;
+
+    if (header.fail() or word != "render")
+        throw ProtocolError("expected 'render <scene id> <width> <height> <priority>'");
+    if (request.width <= 0 or request.height <= 0
+        or request.width > max_image_side or request.height > max_image_side
+        or static_cast<long long>(request.width) * request.height > max_image_pixels)
+        throw ProtocolError("bad resolution");
+
+    line = reader.read_line();
+    if (not line)
+        throw ProtocolError("expected 'camera ...'");
+
+    // Hexadecimal floats don't go through operator>>, strtof reads both.
+    std::istringstream camera_line(*line);
+    camera_line >> word;
+
+    if (word != "camera")
+        throw ProtocolError("expected 'camera' with 12 numbers");
+
+    float values[12];
+    for (float& value : values)
+    {
+        std::string number;
+        camera_line >> number;
+
+        // All of it a number, or strtof would quietly take it as 0.
+        char* end = nullptr;
+        value = std::strtof(number.c_str(), &end);
+
+        if (camera_line.fail() or end == number.c_str() or *end != '\0')
+            throw ProtocolError("expected 'camera' with 12 numbers");
+    }
+
+    for (float const value : values)
+    {
+        if (not std::isfinite(value))
+            throw ProtocolError("camera numbers have to be finite");
+    }
+
+    request.camera =
+    {
+        .position       = {values[0], values[1], values[2]},
+        .forward        = {values[3], values[4], values[5]},
+        .up             = {values[6], values[7], values[8]},
+        .horizontal_fov = values[9],
+        .aspect_ratio   = static_cast<float>(request.width) / request.height,
+        .shift          = {values[10], values[11]},
+    };
+
+    // Anything else would make the camera basis zero, and the rays NaN.
+    auto const& camera = request.camera;
+
+    float const forward = camera.forward.length();
+    float const up      = camera.up.length();
+
+    if (not (forward > 0) or not (up > 0)
+        or not (camera.forward.cross(camera.up).length() > 1e-6f * forward * up))
+        throw ProtocolError("camera forward and up have to be nonzero and not parallel");
+    if (not (camera.horizontal_fov > 0 and camera.horizontal_fov < std::numbers::pi_v<float>))
+        throw ProtocolError("camera field of view has to be between 0 and pi");
+
+    line = reader.read_line();
+
+    if (line and line->starts_with("scene "))
+    {
+        auto const size = std::stoull(line->substr(6));
+        if (size > max_scene_bytes)
+            throw ProtocolError("scene too large");
+
+        auto scene = reader.read_bytes(size);
+
+        if (not scene)
+            throw ProtocolError("connection closed inside the scene");
+
+        request.scene = std::move(*scene);
+        line          = reader.read_line();
+    }
+
+    if (not line or *line != "end")
+        throw ProtocolError("expected 'end'");
+
+    return request;
+}
+
+#endif // SERVICE_RENDER_PROTOCOL_H
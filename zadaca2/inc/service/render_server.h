@@ -0,0 +1,322 @@
+#ifndef SERVICE_RENDER_SERVER_H
+#define SERVICE_RENDER_SERVER_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <linear_algebra.h>
+#include <lights/shadow_culled_lights.h>
+#include <rendering/camera.h>
+#include <rendering/render.h>
+#include <rendering/render_cache.h>
+#include <scenes/scene_file.h>
+#include <service/render_protocol.h>
+#include <service/unix_socket.h>
+#include <threading/thread_pool.h>
+
+/*
+** A long running renderer that takes jobs over a Unix domain socket.
+**
+** Loaded scenes stay in memory, keyed by id, together with what is
+** built from them before rendering (the shadow caster lists), so only
+** the first job for a scene pays for parsing and building. Their text
+** is limited in total, and past that the least recently used scenes
+** are dropped, to be sent again by the next job that wants them. Every
+** job is cut into bands of rows that go onto one thread pool shared by
+** all connections, ordered by the job's priority, and each band is sent
+** to the client as soon as the ones above it have been.
+*/
+struct WarmScene
+{
+    std::uint64_t      text_hash  {};
+    std::size_t        text_bytes {};
+    SceneFile          scene      {};
+    ShadowCulledLights lights     {};
+};
+
+class RenderServer
+{
+public:
+    // Rows rendered as one task.
+    static constexpr int band_rows = 8;
+    // How long a client has to send each request, after which its
+    // connection is closed and its slot freed.
+    static constexpr std::chrono::seconds request_timeout {30};
+    // Scene text kept loaded, of all the warm scenes together.
+    static constexpr std::size_t max_warm_bytes = std::size_t{256} << 20;
+
+    explicit RenderServer(
+        unsigned const thread_count    = std::max(1u, std::thread::hardware_concurrency()),
+        int      const max_connections = 64)
+        : pool_{thread_count}
+        , max_connections_{max_connections}
+    {}
+
+    // Accepts connections at path until the process is stopped.
+    void serve(std::string const& path)
+    {
+        auto const listener = listen_unix(path);
+
+        std::cout << "serving on " << path << " with "
+                  << pool_.size() << " threads" << std::endl;
+
+        while (true)
+        {
+            int const fd = ::accept(listener.fd(), nullptr, nullptr);
+
+            if (fd < 0)
+                continue;
+
+            Socket connection(fd);
+
+            // Every connection has a thread of its own, and each can hold
+            // a whole image, so there is a limit to how many are served
+            // at once; the rest are turned away instead of queued.
+            if (connections_.fetch_add(1) >= max_connections_)
+            {
+                --connections_;
+                (void) write_all(connection, "error too many connections\n");
+                continue;
+            }
+
+            std::thread([this, connection = std::move(connection)]() mutable
+            {
+                handle(std::move(connection));
+                --connections_;
+            }).detach();
+        }
+    }
+
+private:
+    struct Job
+    {
+        std::mutex              mutex     {};
+        std::condition_variable finished  {};
+        std::vector<char>       done      {};
+        // The image as PPM pixel bytes, filled in band by band.
+        std::string             pixels    {};
+        std::atomic<bool>       cancelled {};
+    };
+
+    void handle(Socket const connection)
+    {
+        SocketReader reader(connection);
+
+        while (true)
+        {
+            reader.set_deadline(std::chrono::steady_clock::now() + request_timeout);
+
+            try
+            {
+                auto const request = read_request(reader);
+                if (not request)
+                    return;
+
+                if (not render(*request, connection))
+                    return;
+            }
+            catch (std::exception const& error)
+            {
+                // The stream may be out of step with the requests now,
+                // so the connection ends here.
+                (void) write_all(connection, std::string("error ") + error.what() + '\n');
+                return;
+            }
+        }
+    }
+
+    // The scene a request refers to, loading it if it came with one.
+    [[nodiscard]]
+    std::shared_ptr<WarmScene const> find_scene(RenderRequest const& request)
+    {
+        std::unique_lock lock(scenes_mutex_);
+
+        auto const found = scenes_.find(request.scene_id);
+
+        if (not request.scene)
+        {
+            if (found == scenes_.end())
+                throw ProtocolError("unknown scene '" + request.scene_id + "', send it with the request");
+
+            found->second.last_used = ++uses_;
+            return found->second.scene;
+        }
+
+        auto const hash = content_hash(*request.scene);
+
+        if (found != scenes_.end() and found->second.scene->text_hash == hash)
+        {
+            found->second.last_used = ++uses_;
+            return found->second.scene;
+        }
+
+        // Parsing and building can take a while, and needn't hold up
+        // jobs for other scenes.
+        lock.unlock();
+
+        auto warm = std::make_shared<WarmScene>();
+
+        std::istringstream text(*request.scene);
+        warm->text_hash  = hash;
+        warm->text_bytes = request.scene->size();
+        warm->scene      = parse_scene(text);
+        warm->lights     = build_shadow_culled_lights(warm->scene.lights, warm->scene.objects);
+
+        lock.lock();
+        scenes_[request.scene_id] = {.scene = warm, .last_used = ++uses_};
+
+        evict_scenes(request.scene_id);
+
+        return warm;
+    }
+
+    // Drops the least recently used scenes other than keep until the
+    // warm ones fit in max_warm_bytes. Jobs rendering one keep it alive.
+    void evict_scenes(std::string const& keep)
+    {
+        std::size_t bytes = 0;
+
+        for (auto const& [id, entry] : scenes_)
+            bytes += entry.scene->text_bytes;
+
+        while (bytes > max_warm_bytes)
+        {
+            auto oldest = scenes_.end();
+
+            for (auto it = scenes_.begin(); it != scenes_.end(); ++it)
+            {
+                if (it->first != keep and (oldest == scenes_.end() or it->second.last_used < oldest->second.last_used))
+                    oldest = it;
+            }
+
+            if (oldest == scenes_.end())
+                return;
+
+            bytes -= oldest->second.scene->text_bytes;
+            scenes_.erase(oldest);
+        }
+    }
+
+    // False once the client has gone away.
+    [[nodiscard]]
+    bool render(
+        RenderRequest const& request,
+        Socket        const& connection)
+    {
+        using clock = std::chrono::steady_clock;
+        using std::chrono::duration;
+
+        auto const start = clock::now();
+        auto const scene = find_scene(request);
+        auto const ready = clock::now();
+
+        auto const rays  = std::make_shared<CameraRays>(
+            make_camera_rays(request.camera, request.width, request.height)
+        );
+        int  const bands = (request.height + band_rows - 1) / band_rows;
+        auto const job   = std::make_shared<Job>();
+
+        job->done.assign(bands, 0);
+        job->pixels.resize(3ull * request.width * request.height);
+
+        for (int band = 0; band < bands; ++band)
+        {
+            pool_.submit(request.priority, [scene, rays, job, band]
+            {
+                if (not job->cancelled)
+                {
+                    int const first = band * band_rows;
+                    int const count = std::min(band_rows, rays->height - first);
+
+                    std::vector<float3> rows(count * rays->width);
+
+                    render_rows(*rays, first, count,
+                        scene->scene.objects, scene->scene.materials, scene->lights,
+                        rows.data()
+                    );
+
+                    to_pixel_bytes(rows.data(), rows.size(),
+                        job->pixels.data() + 3ull * first * rays->width
+                    );
+                }
+
+                {
+                    std::lock_guard const lock(job->mutex);
+                    job->done[band] = 1;
+                }
+
+                job->finished.notify_all();
+            });
+        }
+
+        // Goes out with the first band, so a client that sees the header
+        // can count on pixels following right away.
+        std::ostringstream header;
+        header << "P6\n" << request.width << ' ' << request.height << "\n255\n";
+
+        auto const band_bytes = 3ull * band_rows * request.width;
+
+        bool connected = true;
+
+        for (int band = 0; band < bands and connected; ++band)
+        {
+            {
+                std::unique_lock lock(job->mutex);
+                job->finished.wait(lock, [&] { return job->done[band] != 0; });
+            }
+
+            auto const begin  = band * band_bytes;
+            auto const size   = std::min<std::size_t>(band_bytes, job->pixels.size() - begin);
+            auto const pixels = std::string_view(job->pixels).substr(begin, size);
+
+            connected = band == 0
+                ? write_all(connection, header.str() + std::string(pixels))
+                : write_all(connection, pixels);
+        }
+
+        // Whatever hasn't started yet is of no use to anyone.
+        job->cancelled = not connected;
+
+        std::cout << "scene " << request.scene_id << ' '
+                  << request.width << 'x' << request.height
+                  << " priority " << request.priority << ": "
+                  << (request.scene ? "load " : "warm ")
+                  << duration<double, std::milli>(ready - start).count() << " ms, "
+                  << "render " << duration<double, std::milli>(clock::now() - ready).count() << " ms"
+                  << (connected ? "" : ", client gone")
+                  << std::endl;
+
+        return connected;
+    }
+
+    ThreadPool pool_;
+
+    int              const max_connections_;
+    std::atomic<int>       connections_     {};
+
+    struct CachedScene
+    {
+        std::shared_ptr<WarmScene const> scene     {};
+        // When a job last used it, in jobs since the server started.
+        std::uint64_t                    last_used {};
+    };
+
+    std::mutex                                   scenes_mutex_ {};
+    std::unordered_map<std::string, CachedScene> scenes_       {};
+    std::uint64_t                                uses_         {};
+};
+
+#endif // SERVICE_RENDER_SERVER_H
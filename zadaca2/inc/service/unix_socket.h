@@ -0,0 +1,231 @@
+#ifndef SERVICE_UNIX_SOCKET_H
+#define SERVICE_UNIX_SOCKET_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#include <cerrno>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/*
+** Thin wrappers over POSIX stream sockets in the Unix domain. Failures
+** to set a socket up throw std::system_error; reads and writes on an
+** open one report a closed or broken connection through their return
+** value, since the other end going away is expected.
+*/
+
+// Owns a file descriptor and closes it.
+class Socket
+{
+public:
+    Socket() = default;
+
+    explicit Socket(int const fd) noexcept
+        : fd_{fd}
+    {}
+
+    Socket(Socket&& other) noexcept
+        : fd_{std::exchange(other.fd_, -1)}
+    {}
+
+    Socket& operator=(Socket&& other) noexcept
+    {
+        std::swap(fd_, other.fd_);
+        return *this;
+    }
+
+    ~Socket()
+    {
+        if (fd_ >= 0)
+            ::close(fd_);
+    }
+
+    [[nodiscard]]
+    int fd() const noexcept
+    {
+        return fd_;
+    }
+
+private:
+    int fd_ {-1};
+};
+
+[[nodiscard]]
+inline sockaddr_un unix_address(std::string const& path)
+{
+    sockaddr_un address {};
+    address.sun_family = AF_UNIX;
+
+    if (path.size() >= sizeof(address.sun_path))
+        throw std::invalid_argument("socket path too long: " + path);
+
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    return address;
+}
+
+[[nodiscard]]
+inline Socket make_unix_socket()
+{
+    Socket socket(::socket(AF_UNIX, SOCK_STREAM, 0));
+
+    if (socket.fd() < 0)
+        throw std::system_error(errno, std::system_category(), "socket");
+
+    return socket;
+}
+
+// Listens at path, replacing whatever socket was left there.
+[[nodiscard]]
+inline Socket listen_unix(std::string const& path)
+{
+    auto       socket  = make_unix_socket();
+    auto const address = unix_address(path);
+
+    ::unlink(path.c_str());
+
+    if (::bind(socket.fd(), reinterpret_cast<sockaddr const*>(&address), sizeof(address)) != 0)
+        throw std::system_error(errno, std::system_category(), "bind " + path);
+
+    if (::listen(socket.fd(), SOMAXCONN) != 0)
+        throw std::system_error(errno, std::system_category(), "listen " + path);
+
+    return socket;
+}
+
+[[nodiscard]]
+inline Socket connect_unix(std::string const& path)
+{
+    auto       socket  = make_unix_socket();
+    auto const address = unix_address(path);
+
+    if (::connect(socket.fd(), reinterpret_cast<sockaddr const*>(&address), sizeof(address)) != 0)
+        throw std::system_error(errno, std::system_category(), "connect " + path);
+
+    return socket;
+}
+
+// False once the other end has gone away.
+[[nodiscard]]
+inline bool write_all(
+    Socket           const& socket,
+    std::string_view        bytes)
+{
+    while (not bytes.empty())
+    {
+        auto const written = ::send(socket.fd(), bytes.data(), bytes.size(), MSG_NOSIGNAL);
+
+        if (written < 0 and errno == EINTR)
+            continue;
+        if (written <= 0)
+            return false;
+
+        bytes.remove_prefix(static_cast<std::size_t>(written));
+    }
+
+    return true;
+}
+
+/*
+** Buffered reads of newline terminated text and of counted bytes from
+** the same socket.
+*/
+class SocketReader
+{
+public:
+    explicit SocketReader(Socket const& socket) noexcept
+        : socket_{&socket}
+    {}
+
+    // The next line without its '\n', or nothing at the end of the stream.
+    [[nodiscard]]
+    std::optional<std::string> read_line()
+    {
+        std::size_t end;
+
+        while ((end = buffer_.find('\n')) == std::string::npos)
+        {
+            if (not fill())
+                return std::nullopt;
+        }
+
+        std::string line = buffer_.substr(0, end);
+        buffer_.erase(0, end + 1);
+
+        return line;
+    }
+
+    // Reads give up, as if the stream had ended, once deadline passes.
+    void set_deadline(std::chrono::steady_clock::time_point const deadline) noexcept
+    {
+        deadline_ = deadline;
+    }
+
+    // Exactly count bytes, or nothing if the stream ends first.
+    [[nodiscard]]
+    std::optional<std::string> read_bytes(std::size_t const count)
+    {
+        while (buffer_.size() < count)
+        {
+            if (not fill())
+                return std::nullopt;
+        }
+
+        std::string bytes = buffer_.substr(0, count);
+        buffer_.erase(0, count);
+
+        return bytes;
+    }
+
+private:
+    bool fill()
+    {
+        char chunk[1 << 16];
+
+        while (true)
+        {
+            if (deadline_ != std::chrono::steady_clock::time_point::max())
+            {
+                auto const left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    deadline_ - std::chrono::steady_clock::now()
+                );
+
+                pollfd readable {socket_->fd(), POLLIN, 0};
+
+                int const ready = ::poll(&readable, 1, static_cast<int>(std::max<long long>(0, left.count())));
+
+                if (ready < 0 and errno == EINTR)
+                    continue;
+                if (ready <= 0)
+                    return false;
+            }
+
+            auto const received = ::recv(socket_->fd(), chunk, sizeof(chunk), 0);
+
+            if (received < 0 and errno == EINTR)
+                continue;
+            if (received <= 0)
+                return false;
+
+            buffer_.append(chunk, static_cast<std::size_t>(received));
+            return true;
+        }
+    }
+
+    Socket const*                         socket_   {};
+    std::string                           buffer_   {};
+    std::chrono::steady_clock::time_point deadline_ = std::chrono::steady_clock::time_point::max();
+};
+
+#endif // SERVICE_UNIX_SOCKET_H
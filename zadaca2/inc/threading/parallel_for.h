@@ -0,0 +1,39 @@
+#ifndef THREADING_PARALLEL_FOR_H
+#define THREADING_PARALLEL_FOR_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+/*
+** Calls f(i) for every i in [0, count) on all hardware threads.
+** Indices are handed out one at a time from a shared counter, so
+** uneven work per index still balances out. Returns once every call
+** has finished.
+*/
+template <typename F>
+void parallel_for(std::size_t const count, F&& f)
+{
+    auto const thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+    std::atomic<std::size_t> next = 0;
+
+    auto const worker = [&]
+    {
+        for (std::size_t i = next++; i < count; i = next++)
+            f(i);
+    };
+
+    {
+        std::vector<std::jthread> threads;
+
+        for (unsigned t = 1; t < thread_count; ++t)
+            threads.emplace_back(worker);
+
+        worker();
+    }
+}
+
+#endif // THREADING_PARALLEL_FOR_H
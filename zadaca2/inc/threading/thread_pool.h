@@ -0,0 +1,97 @@
+#ifndef THREADING_THREAD_POOL_H
+#define THREADING_THREAD_POOL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/*
+** A fixed set of worker threads shared by everything submitted to it.
+**
+** Tasks with a higher priority run first, and tasks of equal priority
+** in the order they were submitted. Work is meant to be submitted in
+** small pieces, so a high priority job that arrives while a long one
+** is running only waits for the pieces already started.
+*/
+class ThreadPool
+{
+public:
+    explicit ThreadPool(unsigned const thread_count = std::max(1u, std::thread::hardware_concurrency()))
+    {
+        for (unsigned t = 0; t < thread_count; ++t)
+            workers_.emplace_back([this](std::stop_token const stop) { work(stop); });
+    }
+
+    ThreadPool(ThreadPool const&)            = delete;
+    ThreadPool& operator=(ThreadPool const&) = delete;
+
+    void submit(int const priority, std::function<void()> task)
+    {
+        {
+            std::lock_guard const lock(mutex_);
+            tasks_.push({priority, next_sequence_++, std::move(task)});
+        }
+
+        ready_.notify_one();
+    }
+
+    [[nodiscard]]
+    unsigned size() const noexcept
+    {
+        return static_cast<unsigned>(workers_.size());
+    }
+
+private:
+    struct Task
+    {
+        int                   priority {};
+        std::uint64_t         sequence {};
+        std::function<void()> run      {};
+
+        // Ordered so the top of the queue is the task to run next.
+        [[nodiscard]]
+        bool operator<(Task const& other) const noexcept
+        {
+            if (priority != other.priority)
+                return priority < other.priority;
+
+            return sequence > other.sequence;
+        }
+    };
+
+    void work(std::stop_token const stop)
+    {
+        while (true)
+        {
+            Task task;
+
+            {
+                std::unique_lock lock(mutex_);
+
+                if (not ready_.wait(lock, stop, [&] { return not tasks_.empty(); }))
+                    return;
+
+                task = tasks_.top();
+                tasks_.pop();
+            }
+
+            task.run();
+        }
+    }
+
+    std::mutex                  mutex_         {};
+    std::condition_variable_any ready_         {};
+    std::priority_queue<Task>   tasks_         {};
+    std::uint64_t               next_sequence_ {};
+
+    // Last, so the workers are stopped and joined before the queue they
+    // use goes away; stopping wakes the ones waiting for a task.
+    std::vector<std::jthread>   workers_       {};
+};
+
+#endif // THREADING_THREAD_POOL_H
@@ -0,0 +1,133 @@
+#ifndef THREADING_TOPOLOGY_H
+#define THREADING_TOPOLOGY_H
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+
+/*
+** Which CPUs share a memory controller, from what Linux reports in
+** /sys, without linking libnuma.
+**
+** Memory a thread touches first is allocated on the node of the CPU it
+** runs on. A thread kept on one node's CPUs therefore allocates, and
+** then finds, its working memory on that node; one the scheduler moves
+** to another socket reads all of it across the interconnect.
+*/
+struct NumaNode
+{
+    int              id   {};
+    std::vector<int> cpus {};
+};
+
+// "0-3,8,10-11" as its CPUs.
+[[nodiscard]]
+inline std::vector<int> parse_cpu_list(std::string const& list)
+{
+    std::vector<int>  cpus;
+    std::stringstream ranges(list);
+    std::string       range;
+
+    while (std::getline(ranges, range, ','))
+    {
+        if (range.empty() or range == "\n")
+            continue;
+
+        auto const dash  = range.find('-');
+        int  const first = std::stoi(range.substr(0, dash));
+        int  const last  = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+
+        for (int cpu = first; cpu <= last; ++cpu)
+            cpus.push_back(cpu);
+    }
+
+    return cpus;
+}
+
+// The CPUs this process may run on.
+[[nodiscard]]
+inline std::vector<int> allowed_cpus()
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+
+    std::vector<int> cpus;
+
+    if (::sched_getaffinity(0, sizeof(set), &set) == 0)
+    {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+            if (CPU_ISSET(cpu, &set))
+                cpus.push_back(cpu);
+    }
+
+    return cpus;
+}
+
+/*
+** The nodes with CPUs this process may use, in order, each with those
+** of its CPUs. Without NUMA information it is one node with all of
+** them.
+*/
+[[nodiscard]]
+inline std::vector<NumaNode> numa_topology()
+{
+    auto const allowed = allowed_cpus();
+
+    std::vector<NumaNode> nodes;
+
+    std::error_code error;
+
+    for (auto const& entry : std::filesystem::directory_iterator("/sys/devices/system/node", error))
+    {
+        auto const name = entry.path().filename().string();
+
+        if (not name.starts_with("node") or name.size() == 4
+            or not std::all_of(name.begin() + 4, name.end(), [](char const c) { return c >= '0' and c <= '9'; }))
+            continue;
+
+        std::ifstream file(entry.path() / "cpulist");
+        std::string   list;
+        std::getline(file, list);
+
+        NumaNode node {.id = std::stoi(name.substr(4))};
+
+        for (int const cpu : parse_cpu_list(list))
+            if (std::find(allowed.begin(), allowed.end(), cpu) != allowed.end())
+                node.cpus.push_back(cpu);
+
+        if (not node.cpus.empty())
+            nodes.push_back(std::move(node));
+    }
+
+    std::sort(nodes.begin(), nodes.end(), [](auto const& a, auto const& b) { return a.id < b.id; });
+
+    if (nodes.empty())
+        nodes.push_back({.id = 0, .cpus = allowed});
+
+    return nodes;
+}
+
+// Keeps the calling thread on cpus; false if the system refuses.
+inline bool pin_current_thread(std::vector<int> const& cpus)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+
+    for (int const cpu : cpus)
+        CPU_SET(cpu, &set);
+
+    return ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set) == 0;
+}
+
+inline bool pin_current_thread(int const cpu)
+{
+    return pin_current_thread(std::vector<int>{cpu});
+}
+
+#endif // THREADING_TOPOLOGY_H
@@ -0,0 +1,275 @@
+#ifndef THREADING_WORK_STEALING_POOL_H
+#define THREADING_WORK_STEALING_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <threading/topology.h>
+
+/*
+** Worker threads that each keep their own queue of tasks and, when it
+** runs dry, take from the others', those on the same NUMA node first.
+**
+** When NUMA aware, the workers are split over the nodes in proportion
+** and each is pinned to one CPU of its node, so the scheduler cannot move
+** it, and with it everything it allocates, to another socket. Tasks can
+** be submitted to a node, so those working on one part of memory stay
+** where that memory is; a worker only leaves its node for work once
+** every queue there is empty. Without it, it is a plain work stealing
+** pool, unpinned, that treats the machine as one node.
+**
+** With fewer workers than nodes, only the first nodes are used, one
+** worker each, so every node the pool has has a worker to queue to.
+*/
+class WorkStealingPool
+{
+public:
+    explicit WorkStealingPool(
+        unsigned const thread_count = std::max(1u, std::thread::hardware_concurrency()),
+        bool     const numa_aware   = true)
+    {
+        if (numa_aware)
+            nodes_ = numa_topology();
+        else
+            nodes_ = {{.id = 0, .cpus = {}}};
+
+        unsigned const count = std::max(1u, thread_count);
+
+        if (nodes_.size() > count)
+            nodes_.resize(count);
+
+        node_workers_.resize(nodes_.size());
+        next_on_node_ = std::make_unique<std::atomic<unsigned>[]>(nodes_.size());
+
+        for (unsigned t = 0; t < count; ++t)
+        {
+            // Contiguous, so workers next to each other share a node.
+            int const node = static_cast<int>(static_cast<std::size_t>(t) * nodes_.size() / count);
+
+            queues_.push_back(std::make_unique<Queue>());
+            queues_.back()->node = node;
+            node_workers_[node].push_back(t);
+        }
+
+        for (unsigned t = 0; t < count; ++t)
+            victims_.push_back(steal_order(t));
+
+        for (unsigned t = 0; t < count; ++t)
+        {
+            int const node = queues_[t]->node;
+            int const cpu  = nodes_[node].cpus.empty() ? -1
+                : nodes_[node].cpus[(t - node_workers_[node].front()) % nodes_[node].cpus.size()];
+
+            workers_.emplace_back([this, t, node, cpu](std::stop_token const stop)
+            {
+                if (cpu >= 0)
+                    pin_current_thread(cpu);
+
+                current_node_ = node;
+                work(t, stop);
+            });
+        }
+    }
+
+    WorkStealingPool(WorkStealingPool const&)            = delete;
+    WorkStealingPool& operator=(WorkStealingPool const&) = delete;
+
+    // Queues task on a worker of node, or of any node for -1.
+    void submit(std::function<void()> task, int const node = -1)
+    {
+        unsigned worker;
+
+        if (node < 0)
+            worker = next_++ % queues_.size();
+        else
+        {
+            auto const& on_node = node_workers_[node % nodes_.size()];
+            worker = on_node[next_on_node_[node % nodes_.size()]++ % on_node.size()];
+        }
+
+        {
+            // Counted under the same lock a worker takes to uncount it,
+            // so the count can't go below zero.
+            std::lock_guard const lock(mutex_);
+            std::lock_guard const queue_lock(queues_[worker]->mutex);
+
+            queues_[worker]->tasks.push_back(std::move(task));
+            ++queued_;
+        }
+
+        ready_.notify_one();
+    }
+
+    /*
+    ** Calls f(node) for every node on a thread kept on that node's CPUs,
+    ** so what f allocates and first writes is in that node's memory, and
+    ** returns once they are all done. Not NUMA aware, it is f(0) here.
+    */
+    template <typename F>
+    void run_on_each_node(F&& f)
+    {
+        if (nodes_.size() == 1 and nodes_.front().cpus.empty())
+        {
+            f(0);
+            return;
+        }
+
+        std::vector<std::jthread> threads;
+
+        for (std::size_t node = 0; node < nodes_.size(); ++node)
+        {
+            threads.emplace_back([&, node]
+            {
+                pin_current_thread(nodes_[node].cpus);
+                f(static_cast<int>(node));
+            });
+        }
+    }
+
+    [[nodiscard]]
+    unsigned size() const noexcept
+    {
+        return static_cast<unsigned>(workers_.size());
+    }
+
+    [[nodiscard]]
+    int node_count() const noexcept
+    {
+        return static_cast<int>(nodes_.size());
+    }
+
+    [[nodiscard]]
+    std::vector<NumaNode> const& nodes() const noexcept
+    {
+        return nodes_;
+    }
+
+    // The node of the worker calling it, or 0 outside any pool.
+    [[nodiscard]]
+    static int current_node() noexcept
+    {
+        return current_node_;
+    }
+
+private:
+    struct Queue
+    {
+        int                               node  {};
+        std::mutex                        mutex {};
+        std::deque<std::function<void()>> tasks {};
+    };
+
+    // The other workers, those on worker's node first, each group
+    // starting after it so thieves spread out.
+    [[nodiscard]]
+    std::vector<unsigned> steal_order(unsigned const worker) const
+    {
+        std::vector<unsigned> order;
+
+        // Where worker is among its node's.
+        std::size_t const start = worker - node_workers_[queues_[worker]->node].front();
+
+        for (std::size_t n = 0; n < nodes_.size(); ++n)
+        {
+            int  const  node    = static_cast<int>((queues_[worker]->node + n) % nodes_.size());
+            auto const& members = node_workers_[node];
+
+            for (std::size_t k = 1; k <= members.size(); ++k)
+            {
+                unsigned const victim = members[(start + k) % members.size()];
+
+                if (victim != worker)
+                    order.push_back(victim);
+            }
+        }
+
+        return order;
+    }
+
+    // The oldest of worker's own tasks, or the newest of a victim's.
+    [[nodiscard]]
+    std::function<void()> take(unsigned const worker)
+    {
+        {
+            auto& own = *queues_[worker];
+
+            std::lock_guard const lock(own.mutex);
+
+            if (not own.tasks.empty())
+            {
+                auto task = std::move(own.tasks.front());
+                own.tasks.pop_front();
+                return task;
+            }
+        }
+
+        for (unsigned const victim : victims_[worker])
+        {
+            auto& queue = *queues_[victim];
+
+            std::lock_guard const lock(queue.mutex);
+
+            if (not queue.tasks.empty())
+            {
+                auto task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+                return task;
+            }
+        }
+
+        return {};
+    }
+
+    void work(unsigned const worker, std::stop_token const stop)
+    {
+        while (true)
+        {
+            {
+                std::unique_lock lock(mutex_);
+
+                if (not ready_.wait(lock, stop, [&] { return queued_ > 0; }))
+                    return;
+            }
+
+            // Another worker may have got there first.
+            if (auto task = take(worker))
+            {
+                {
+                    std::lock_guard const lock(mutex_);
+                    --queued_;
+                }
+
+                task();
+            }
+            else
+                std::this_thread::yield();
+        }
+    }
+
+    static inline thread_local int current_node_ = 0;
+
+    std::vector<NumaNode>                     nodes_        {};
+    std::vector<std::vector<unsigned>>        node_workers_ {};
+    std::unique_ptr<std::atomic<unsigned>[]>  next_on_node_ {};
+    std::atomic<unsigned>                     next_         {};
+    std::vector<std::unique_ptr<Queue>>       queues_       {};
+    std::vector<std::vector<unsigned>>        victims_      {};
+
+    std::mutex                                mutex_        {};
+    std::condition_variable_any               ready_        {};
+    // Tasks in all the queues together.
+    std::size_t                               queued_       {};
+
+    // Last, so the workers are stopped and joined before the queues they
+    // use go away; stopping wakes the ones waiting for a task.
+    std::vector<std::jthread>                 workers_      {};
+};
+
+#endif // THREADING_WORK_STEALING_POOL_H
@@ -3,8 +3,18 @@
 #include <cmath>
 #include <cstdint>
 
+#include <algorithm>
+#include <filesystem>
+#include <memory>
+#include <optional>
+
 #include <vector>
 #include <fstream>
+#include <string>
+#include <string_view>
+#include <sstream>
+#include <stdexcept>
+#include <chrono>
 
 #include <linear_algebra.h>
 
@@ -13,108 +23,507 @@
 #include <objects/cylinder.h>
 #include <objects/cuboid.h>
 
+#include <lights/area_lights.h>
+#include <lights/light_tree.h>
+#include <lights/point_light_array.h>
+#include <lights/shadow_culled_lights.h>
+#include <lights/shadow_mapped_lights.h>
+
 #include <rays/ray.h>
 #include <rays/tracing.h>
 
-template <int w, int h> [[nodiscard]]
-std::vector<float3> render(
-    std::vector<Object const*> const& objects,
-    std::vector<PointLight   > const& lights)
+#include <scenes/static_scene.h>
+
+#include <rendering/camera.h>
+#include <rendering/render.h>
+#include <rendering/gbuffer.h>
+#include <rendering/rasterization.h>
+#include <rendering/denoise.h>
+#include <rendering/ambient_occlusion.h>
+#include <rendering/dirty_tiles.h>
+#include <rendering/render_cache.h>
+#include <rendering/batch.h>
+#include <rendering/tiled_render.h>
+#include <rendering/progressive.h>
+#include <rendering/checkpoint.h>
+#include <rendering/auto_tune.h>
+
+#include <service/render_server.h>
+#include <service/distributed.h>
+
+#include <output/image_encoder.h>
+#include <output/video_stream.h>
+#include <output/tiled_image.h>
+
+int main(int argc, char** argv)
 {
-    auto const half_height = h / 2.f;
-    auto const half_width  = w / 2.f;
-    auto const half_fov    = 3.1415 / 3;
+    bool  use_static_scene   = false;
+    bool  use_light_tree     = false;
+    bool  use_light_array    = false;
+    bool  use_shadow_culling = false;
+    bool  use_shadow_maps    = false;
+    bool  use_gbuffer        = false;
+    bool  use_rasterizer     = false;
+    bool  use_denoiser       = false;
+    bool  use_ao             = false;
+    bool  use_area_lights    = false;
+    bool  use_dirty_tiles    = false;
+    float light_threshold    = 0;
+    int   light_samples      = 0;
+
+    ShadowMapSettings        shadow_map_settings {};
+    AmbientOcclusionSettings ao_settings         {};
+    RenderCache              render_cache        {};
+    std::string              server_socket       {};
+    std::string              output_path         = "../renders/kugle.ppm";
+    EncoderSettings          encoder_settings    {};
+    std::string              coordinator_socket  {};
+    std::string              worker_socket       {};
+    std::string              scene_file          = "../scenes/kugle.scene";
+    int                      spawn_workers       = 0;
+    int                      worker_fail_after   = 0;
+    int                      worker_hang_after   = 0;
+    int                      frame_width         = 1920;
+    int                      frame_height        = 1080;
+    DistributedSettings      distributed         {};
+    std::string              camera_path_file    {};
+    int                      batch_frames        = 60;
+    std::string              video_path          {};
+    int                      video_fps           = 30;
+    std::string              untile_path         {};
+    int                      progressive_samples = 0;
+    std::string              checkpoint_path     {};
+    ProgressiveSettings      progressive         {};
+    bool                     resume              = false;
+    bool                     auto_tune           = false;
+    bool                     retune              = false;
+    std::filesystem::path    tuning_file         = default_tuning_file();
+    bool                     numa_aware          = true;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string_view const arg = argv[i];
+
+        if (arg == "--static-scene")
+            use_static_scene = true;
+        else if (arg == "--light-tree")
+            use_light_tree = true;
+        else if (arg == "--simd-lights")
+            use_light_array = true;
+        else if (arg == "--shadow-culling")
+            use_shadow_culling = true;
+        else if (arg == "--gbuffer")
+            use_gbuffer = true;
+        else if (arg == "--raster-primary")
+            use_rasterizer = true;
+        else if (arg == "--denoise")
+            use_denoiser = true;
+        else if (arg == "--ambient-occlusion")
+            use_ao = true;
+        else if (arg == "--ao-half-resolution")
+            ao_settings.half_resolution = true;
+        else if (arg.starts_with("--ao-radius="))
+            ao_settings.radius = std::stof(std::string{arg.substr(12)});
+        else if (arg.starts_with("--ao-samples="))
+            ao_settings.samples = std::stoi(std::string{arg.substr(13)});
+        else if (arg == "--area-lights")
+            use_area_lights = true;
+        else if (arg == "--dirty-tiles")
+            use_dirty_tiles = true;
+        else if (arg == "--shadow-maps")
+            use_shadow_maps = true;
+        else if (arg.starts_with("--shadow-map-resolution="))
+            shadow_map_settings.resolution = std::stoi(std::string{arg.substr(24)});
+        else if (arg.starts_with("--shadow-map-bias="))
+            shadow_map_settings.constant_bias = std::stof(std::string{arg.substr(18)});
+        else if (arg.starts_with("--shadow-map-slope-bias="))
+            shadow_map_settings.slope_bias = std::stof(std::string{arg.substr(24)});
+        else if (arg.starts_with("--shadow-map-filter="))
+            shadow_map_settings.filter_radius = std::stoi(std::string{arg.substr(20)});
+        else if (arg.starts_with("--light-threshold="))
+            light_threshold = std::stof(std::string{arg.substr(18)});
+        else if (arg.starts_with("--light-samples="))
+            light_samples = std::stoi(std::string{arg.substr(16)});
+        else if (arg.starts_with("--cache-dir="))
+            render_cache.directory = arg.substr(12);
+        else if (arg.starts_with("--cache-size-mb="))
+            render_cache.max_bytes = std::stoull(std::string{arg.substr(16)}) << 20;
+        else if (arg.starts_with("--output="))
+            output_path = arg.substr(9);
+        else if (arg == "--dither")
+            encoder_settings.dither = true;
+        else if (arg.starts_with("--serve="))
+            server_socket = arg.substr(8);
+        else if (arg.starts_with("--coordinate="))
+            coordinator_socket = arg.substr(13);
+        else if (arg.starts_with("--worker="))
+            worker_socket = arg.substr(9);
+        else if (arg.starts_with("--spawn-workers="))
+            spawn_workers = std::stoi(std::string{arg.substr(16)});
+        else if (arg.starts_with("--worker-fail-after="))
+            worker_fail_after = std::stoi(std::string{arg.substr(20)});
+        else if (arg.starts_with("--worker-hang-after="))
+            worker_hang_after = std::stoi(std::string{arg.substr(20)});
+        else if (arg.starts_with("--tile-timeout-ms="))
+            distributed.tile_timeout = std::chrono::milliseconds(std::stoi(std::string{arg.substr(18)}));
+        else if (arg.starts_with("--scene="))
+            scene_file = arg.substr(8);
+        else if (arg.starts_with("--frame-width="))
+            frame_width = std::stoi(std::string{arg.substr(14)});
+        else if (arg.starts_with("--frame-height="))
+            frame_height = std::stoi(std::string{arg.substr(15)});
+        else if (arg.starts_with("--tile-size="))
+            distributed.tile_size = std::stoi(std::string{arg.substr(12)});
+        else if (arg.starts_with("--batch="))
+            camera_path_file = arg.substr(8);
+        else if (arg.starts_with("--batch-frames="))
+            batch_frames = std::stoi(std::string{arg.substr(15)});
+        else if (arg.starts_with("--video="))
+            video_path = arg.substr(8);
+        else if (arg.starts_with("--video-fps="))
+            video_fps = std::stoi(std::string{arg.substr(12)});
+        else if (arg.starts_with("--untile="))
+            untile_path = arg.substr(9);
+        else if (arg.starts_with("--samples="))
+            progressive_samples = std::stoi(std::string{arg.substr(10)});
+        else if (arg.starts_with("--checkpoint="))
+            checkpoint_path = arg.substr(13);
+        else if (arg.starts_with("--checkpoint-interval="))
+            progressive.checkpoint_interval = std::chrono::seconds(std::stoi(std::string{arg.substr(22)}));
+        else if (arg.starts_with("--adaptive-threshold="))
+            progressive.error_threshold = std::stof(std::string{arg.substr(21)});
+        else if (arg.starts_with("--adaptive-min-samples="))
+            progressive.min_samples = std::stoi(std::string{arg.substr(23)});
+        else if (arg.starts_with("--time-budget-ms="))
+            progressive.time_budget = std::chrono::milliseconds(std::stoi(std::string{arg.substr(17)}));
+        else if (arg == "--resume")
+            resume = true;
+        else if (arg == "--auto-tune")
+            auto_tune = true;
+        else if (arg == "--retune")
+            auto_tune = retune = true;
+        else if (arg.starts_with("--tuning-file="))
+            tuning_file = arg.substr(14);
+        else if (arg == "--no-numa")
+            numa_aware = false;
+    }
 
-    std::vector<float3> image(w * h);
+    if (not untile_path.empty())
+    {
+        write_tiled_image_as_ppm(open_tiled_image(untile_path), output_path);
+        return 0;
+    }
 
-    for (int j = 0; j < h; ++j)
+    // Tile size and threads for the frame modes below: as given, or
+    // with --auto-tune as chosen by the last calibration for this host,
+    // kind of scene and pool, calibrating if there is none on pools from
+    // make_pool(threads).
+    auto const tune = [&](SceneFile const& scene, auto const& lights, Camera const& camera,
+                          std::string const& pool, auto const& make_pool)
     {
-        for (int i = 0; i < w; ++i)
-        {
-            /*
-            ** The ray will go through the pixel at
-            **
-            **      (i - half_width, half_height - j)
-            **
-            ** in the near plane, because we have to get
-            ** from the center of the plane to the top-left
-            ** corner.
-            */
-            Ray const ray
+        RenderTuning tuning {.tile_size = distributed.tile_size};
+
+        if (not auto_tune)
+            return tuning;
+
+        auto const host = tuning_host();
+        auto const kind = scene_class(scene) + '-' + pool;
+
+        if (auto const stored = load_tuning(tuning_file, host, kind); stored and not retune)
+            tuning = *stored;
+        else
+        {
+            auto const measurements = calibrate_rendering(make_pool, camera, frame_width, frame_height,
+                scene.objects, scene.materials, lights
+            );
+
+            tuning = measurements.front().tuning;
+
+            store_tuning(tuning_file, host, kind, tuning);
+            log_tuning(std::filesystem::path(tuning_file).replace_extension(".log"), host, kind, measurements);
+
+            std::cout << "calibrated " << measurements.size() << " configurations for " << host << ' ' << kind
+                      << ": fastest " << measurements.front().ms << " ms, slowest " << measurements.back().ms << " ms, "
+                      << "stored in " << tuning_file.string()
+                      << std::endl;
+        }
+
+        std::cout << "tile " << tuning.tile_size << ", " << tuning.threads << " threads"
+                  << std::endl;
+
+        return tuning;
+    };
+
+    // Many samples per pixel, from the scene file, optionally saved as
+    // the render goes and continued from there.
+    if (progressive_samples > 0)
+    {
+        using clock = std::chrono::steady_clock;
+        using std::chrono::duration;
+
+        auto const start = clock::now();
+
+        std::ifstream scene_input(scene_file);
+
+        auto const scene  = parse_scene(scene_input);
+        auto const lights = build_shadow_culled_lights(scene.lights, scene.objects);
+
+        Camera const camera = default_camera(frame_width, frame_height);
+
+        auto const tuning = tune(scene, lights, camera, "shared", [](unsigned const threads)
+        {
+            return std::make_unique<ThreadPool>(threads);
+        });
+
+        auto image = make_progressive_image({
+            .samples_per_pixel = progressive_samples,
+            .width             = frame_width,
+            .height            = frame_height,
+        }, tuning.tile_size);
+
+        std::optional<RenderCheckpoint> checkpoint;
+
+        if (not checkpoint_path.empty())
+        {
+            // Adaptive settings decide which samples are taken, so they
+            // are part of the render.
+            auto const fingerprint = content_hash(
+                read_file(scene_file) + canonical_form(camera, frame_width, frame_height)
+                + canonical_record("adaptive", {progressive.error_threshold, static_cast<float>(progressive.min_samples)})
+            );
+
+            if (resume)
+                checkpoint.emplace(resume_checkpoint(checkpoint_path, image, fingerprint));
+            else
+                checkpoint.emplace(create_checkpoint(checkpoint_path, image, fingerprint));
+        }
+
+        ThreadPool pool(tuning.threads);
+
+        auto const taken = render_progressive(pool, camera, image, scene.objects, scene.materials, lights, progressive,
+            [&](ProgressiveImage const& progress)
             {
-                .source    = {0, 0, 0},
-                .direction = float3
-                {
-                    static_cast<float>(i - half_width),
-                    static_cast<float>(half_height - j) - 100,
-                    static_cast<float>(-half_width / atan(half_fov))
-                }.normalize()
-            };
+                if (not checkpoint)
+                    return;
+
+                auto const saving = clock::now();
+                checkpoint->save(progress);
+
+                std::cout << "checkpoint " << checkpoint->header().generation << ": "
+                          << duration<double, std::milli>(clock::now() - saving).count() << " ms"
+                          << std::endl;
+            }
+        );
 
-            image[j * w + i] = trace<16>(ray, objects, lights);
+        write_image(output_path, resolve_progressive_image(image), frame_width, frame_height, encoder_settings);
+
+        std::cout << frame_width << 'x' << frame_height << ", up to " << progressive_samples << " samples per pixel, "
+                  << static_cast<double>(taken) / (frame_width * frame_height) << " taken per pixel: "
+                  << duration<double, std::milli>(clock::now() - start).count() << " ms"
+                  << std::endl;
+
+        return 0;
+    }
+
+    // Frames of any size, out of core, from the scene file.
+    if (std::filesystem::path(output_path).extension() == ".tiles")
+    {
+        using clock = std::chrono::steady_clock;
+        using std::chrono::duration;
+
+        auto const start = clock::now();
+
+        std::ifstream scene_input(scene_file);
+
+        auto const scene  = parse_scene(scene_input);
+        auto const lights = build_shadow_culled_lights(scene.lights, scene.objects);
+
+        Camera const camera = default_camera(frame_width, frame_height);
+
+        auto const tuning = tune(scene, lights, camera, numa_aware ? "numa" : "stealing", [&](unsigned const threads)
+        {
+            return std::make_unique<WorkStealingPool>(threads, numa_aware);
+        });
+
+        auto image = create_tiled_image(output_path, frame_width, frame_height, tuning.tile_size);
+
+        // Pinned to NUMA nodes, each with its own copy of the scene,
+        // unless --no-numa.
+        WorkStealingPool pool(tuning.threads, numa_aware);
+        render_tiled(pool, camera, image, replicate_scene(pool, read_file(scene_file)));
+
+        std::cout << frame_width << 'x' << frame_height << " in " << image.tile_count() << " tiles on "
+                  << pool.node_count() << (pool.node_count() == 1 ? " node: " : " nodes: ")
+                  << duration<double, std::milli>(clock::now() - start).count() << " ms"
+                  << std::endl;
+
+        return 0;
+    }
+
+    if (not camera_path_file.empty())
+    {
+        using clock = std::chrono::steady_clock;
+        using std::chrono::duration;
+
+        if (batch_frames < 1)
+            throw std::invalid_argument("--batch-frames has to be at least 1");
+
+        // Everything the frames share.
+        auto const start = clock::now();
+
+        std::ifstream scene_input(scene_file);
+        std::ifstream path_input (camera_path_file);
+
+        auto const scene  = parse_scene(scene_input);
+        auto const path   = parse_camera_path(path_input);
+        auto const lights = build_shadow_culled_lights(scene.lights, scene.objects);
+
+        ThreadPool pool;
+
+        double const setup = duration<double, std::milli>(clock::now() - start).count();
+
+        // The frames go to one stream, or to numbered images. Timings go
+        // to stderr when the stream is stdout.
+        std::optional<VideoStream> video;
+        if (not video_path.empty())
+            video.emplace(video_path, frame_width, frame_height, video_fps);
+
+        std::ostream& log = video_path == "-" ? std::cerr : std::cout;
+
+        auto const times = video
+            ? render_batch(pool, path, batch_frames, frame_width, frame_height,
+                  scene.objects, scene.materials, lights,
+                  [&](int, std::vector<float3> const& image) { video->write_frame(image.data()); }
+              )
+            : render_batch(pool, path, batch_frames, frame_width, frame_height,
+                  scene.objects, scene.materials, lights,
+                  frame_files("../renders/frame_%04d.ppm", frame_width, frame_height)
+              );
+
+        double const total = duration<double, std::milli>(clock::now() - start).count();
+
+        for (std::size_t frame = 0; frame < times.size(); ++frame)
+        {
+            log << "frame " << frame << ": "
+                << times[frame].render << " ms, "
+                << "waited " << times[frame].wait << " ms for output"
+                << std::endl;
         }
+
+        log << times.size() << " frames in " << total << " ms, "
+            << total / times.size() << " ms per frame; "
+            << "setup " << setup << " ms once, "
+            << setup / times.size() << " ms per frame amortized"
+            << std::endl;
+
+        return 0;
     }
 
-    return image;
-}
+    if (not worker_socket.empty())
+    {
+        run_render_worker(worker_socket, worker_fail_after, worker_hang_after);
+        return 0;
+    }
 
-template <int width, int height>
-void convert_to_P6(std::vector<float3> const& image)
-{
-    std::ofstream output("../renders/kugle.ppm", std::ofstream::binary);
+    if (not coordinator_socket.empty())
+    {
+        // Workers send back 8 bit tiles, so there is nothing to put in a
+        // float image but those bytes.
+        if (image_format(output_path) == ImageFormat::pfm)
+            throw std::invalid_argument("--coordinate writes 8 bit images only, not " + output_path);
+
+        // The scene from the file, framed like the one below.
+        RenderRequest const job
+        {
+            .scene_id = scene_file,
+            .width    = frame_width,
+            .height   = frame_height,
+            .priority = 0,
+            .camera   = default_camera(frame_width, frame_height),
+            .scene    = read_file(scene_file),
+        };
+
+        auto const listener = listen_unix(coordinator_socket);
+        auto const workers  = spawn_render_workers("/proc/self/exe", coordinator_socket, spawn_workers);
+
+        DistributedStats stats;
+        auto const frame = render_distributed(listener, job, distributed, &stats);
+
+        for (pid_t const worker : workers)
+            ::waitpid(worker, nullptr, 0);
+
+        std::cout << frame_width << 'x' << frame_height << " on "
+                  << stats.workers << " workers: " << stats.ms << " ms, "
+                  << stats.tiles << " tiles, " << stats.reissued << " reissued"
+                  << std::endl;
 
-    output << "P6"                   << std::endl;
-    output << width << ' ' << height << std::endl;
-    output << "255"                  << std::endl;
+        // The workers already went to 8 bits, which the encoder keeps as is.
+        std::vector<float3> image(frame.size() / 3);
+        for (std::size_t i = 0; i < image.size(); ++i)
+        {
+            image[i] = {
+                static_cast<float>(static_cast<unsigned char>(frame[3 * i    ])),
+                static_cast<float>(static_cast<unsigned char>(frame[3 * i + 1])),
+                static_cast<float>(static_cast<unsigned char>(frame[3 * i + 2])),
+            };
+        }
+
+        write_image(output_path, image, frame_width, frame_height);
+
+        return 0;
+    }
 
-    for (int i = 0; i < width * height; ++i)
+    // Scenes then come from the requests rather than from below.
+    if (not server_socket.empty())
     {
-        output << static_cast<unsigned char>(image[i].x)
-               << static_cast<unsigned char>(image[i].y)
-               << static_cast<unsigned char>(image[i].z);
+        RenderServer server;
+        server.serve(server_socket);
+
+        return 0;
     }
-}
 
-int main()
-{
     constexpr Material red {
         {255, 24, 24},
-        0.6, 0.3, 60
+        0.6, 0.3, 60, 0.4
     };
     constexpr Material green {
         {24, 100, 24},
-        0.6, 0.3, 60
+        0.6, 0.3, 60, 0.4
     };
     constexpr Material blue {
         {24, 24, 100,},
-        0.6, 0.3, 60
+        0.6, 0.3, 60, 0.4
     };
     constexpr Material white {
         {255, 255, 255},
-        0.6, 0.3, 60
+        0.6, 0.3, 60, 0.4
     };
 
+    MaterialTable const materials = {red, green, blue, white};
+
+    enum : MaterialIndex { RED, GREEN, BLUE, WHITE };
+
     PointLight light1 { {-20, -149, -50}, 1.4 };
     PointLight light2 { {-35,  120, 0}  , 2   };
     PointLight light3 { {150,  180, 20} , 1   };
 
     constexpr Cuboid floor(
-        white,
+        WHITE,
         {-1000, -200,    0},
         { 1000, -150, -800}
     );
     constexpr Sphere s1(
-        green,
+        GREEN,
         {0, -90, -350},
         60
     );
     constexpr Cylinder v1(
-        red,
+        RED,
         {150, -150, -400},
         25, 65
     );
     constexpr Cuboid c1(
-        blue,
+        BLUE,
         {-200, -149, -300},
         {-125,  -76, -375}
     );
@@ -122,9 +531,240 @@ int main()
     constexpr auto width  = 1920;
     constexpr auto height = 1080;
 
-    auto const image = render<width, height>(
-        {&floor, &s1, &v1, &c1},
-        {light1, light2, light3}
-    );
-    convert_to_P6<width, height>(image);
+    std::vector<PointLight> const lights = {light1, light2, light3};
+
+    Camera const camera = default_camera(width, height);
+
+    auto const render_with = [&](auto const& objects, auto const& lights)
+    {
+        // Ambient occlusion and the denoiser work from the G-buffer, so
+        // they need one.
+        if (use_gbuffer or use_rasterizer or use_denoiser or use_ao)
+        {
+            using clock = std::chrono::steady_clock;
+            using std::chrono::duration;
+
+            auto const start   = clock::now();
+            auto const gbuffer = use_rasterizer
+                ? rasterize_gbuffer<width, height>(camera, objects)
+                : render_gbuffer   <width, height>(camera, objects);
+            auto const traced  = clock::now();
+            auto       image   = relight<width, height>(gbuffer, objects, materials, lights);
+            auto const shaded  = clock::now();
+
+            std::cout << (use_rasterizer ? "rasterized G-buffer: " : "G-buffer: ")
+                      << duration<double, std::milli>(traced - start).count()  << " ms, "
+                      << "relight: "
+                      << duration<double, std::milli>(shaded - traced).count() << " ms"
+                      << std::endl;
+
+            if (use_ao)
+            {
+                auto const ao_start = clock::now();
+                auto const ao       = render_ambient_occlusion(gbuffer, ao_settings);
+
+                apply_ambient_occlusion(image, ao, gbuffer, materials, ao_settings);
+
+                std::cout << "ambient occlusion: "
+                          << duration<double, std::milli>(clock::now() - ao_start).count() << " ms"
+                          << std::endl;
+            }
+
+            if (use_denoiser)
+            {
+                auto const denoise_start = clock::now();
+
+                image = denoise(image, gbuffer, materials);
+
+                std::cout << "denoise: "
+                          << duration<double, std::milli>(clock::now() - denoise_start).count() << " ms"
+                          << std::endl;
+            }
+
+            write_image(output_path, image, width, height, encoder_settings);
+        }
+        else
+        {
+            using clock = std::chrono::steady_clock;
+            using std::chrono::duration;
+
+            // Bands go to the encoder as they are done, so the file is
+            // written while the rest of the image is rendered.
+            constexpr int band_rows = 16;
+
+            auto const start = clock::now();
+            auto const rays  = make_camera_rays(camera, width, height);
+
+            ImageEncoder        encoder(output_path, width, height, encoder_settings);
+            std::vector<float3> band(band_rows * width);
+
+            for (int first = 0; first < height; first += band_rows)
+            {
+                int const count = std::min(band_rows, height - first);
+
+                render_rows(rays, first, count, objects, materials, lights, band.data());
+                encoder.submit(first, count, band.data());
+            }
+
+            auto const rendered = clock::now();
+            encoder.finish();
+
+            std::cout << "render: "
+                      << duration<double, std::milli>(rendered - start).count()     << " ms, "
+                      << "output: "
+                      << duration<double, std::milli>(clock::now() - rendered).count() << " ms after the last row"
+                      << std::endl;
+        }
+    };
+
+    auto const render_scene = [&](auto const& objects)
+    {
+        if (use_area_lights)
+        {
+            // The same lights, grown to give soft shadows.
+            std::vector<AreaLight> const area_lights = {
+                make_sphere_light   (light1.position, 0.8f, light1.intensity),
+                make_rectangle_light(light2.position, {80, 0, 0}, {0, 0, 80}, light2.intensity),
+                make_sphere_light   (light3.position, 20, light3.intensity),
+            };
+
+            render_with(objects,
+                build_area_lights(area_lights, objects)
+            );
+        }
+        else if (use_light_tree)
+        {
+            render_with(objects,
+                build_light_tree(lights, light_threshold, light_samples)
+            );
+        }
+        else if (use_shadow_culling)
+        {
+            render_with(objects,
+                build_shadow_culled_lights(lights, objects)
+            );
+        }
+        else if (use_shadow_maps)
+        {
+            render_with(objects,
+                build_shadow_mapped_lights(lights, objects, shadow_map_settings)
+            );
+        }
+        else if (use_light_array)
+        {
+            render_with(objects,
+                make_point_light_array(lights)
+            );
+        }
+        else
+        {
+            render_with(objects, lights);
+        }
+    };
+
+    if (use_dirty_tiles)
+    {
+        /*
+        ** Configurator style edit: render once, then move a single part
+        ** and re-render only the tiles that part can have an effect on.
+        */
+        using clock = std::chrono::steady_clock;
+        using std::chrono::duration;
+
+        Cylinder part = v1;
+
+        std::vector<Object const*> const objects = {&floor, &s1, &part, &c1};
+
+        auto const start = clock::now();
+        auto frame       = render_tracked<width, height>(camera, objects, materials, lights);
+        auto const full  = clock::now();
+
+        part.center.x -= 60;
+        auto const tiles = rerender_changed<width, height>(
+            frame, objects, materials, lights, {2}
+        );
+        auto const partial = clock::now();
+
+        std::cout << "full render: "
+                  << duration<double, std::milli>(full - start).count() << " ms, "
+                  << "re-render: " << tiles << '/' << frame.tiles.size() << " tiles in "
+                  << duration<double, std::milli>(partial - full).count() << " ms"
+                  << std::endl;
+
+        write_image(output_path, frame.image, width, height, encoder_settings);
+    }
+    else
+    {
+        std::vector<Object const*> const objects = {&floor, &s1, &v1, &c1};
+
+        /*
+        ** Everything besides the scene that changes the pixels. Options
+        ** that only change how the same image is computed, such as the
+        ** scene layout or how primary visibility is found, are left out
+        ** so renders made with and without them share entries.
+        */
+        std::ostringstream settings;
+        settings << std::hexfloat;
+
+        if (use_area_lights)
+            settings << "area-lights";
+        else if (use_light_tree)
+            settings << "light-tree " << light_threshold << ' ' << light_samples;
+        else if (use_shadow_culling)
+            settings << "shadow-culling";
+        else if (use_shadow_maps)
+            settings << "shadow-maps "
+                     << shadow_map_settings.resolution    << ' '
+                     << shadow_map_settings.constant_bias << ' '
+                     << shadow_map_settings.slope_bias    << ' '
+                     << shadow_map_settings.filter_radius;
+        else if (use_light_array)
+            settings << "simd-lights";
+        else
+            settings << "point-lights";
+
+        if (use_ao)
+            settings << " ambient-occlusion "
+                     << ao_settings.radius  << ' '
+                     << ao_settings.samples << ' '
+                     << ao_settings.half_resolution;
+
+        if (use_denoiser)
+            settings << " denoise";
+
+        // The stored file is the output itself.
+        settings << " output " << std::filesystem::path(output_path).extension().string()
+                 << (encoder_settings.dither ? " dither" : "");
+
+        // The static scene holds the same primitives, so both share a key.
+        auto const key = make_render_key(
+            objects, materials, lights, camera, width, height, settings.str()
+        );
+
+        bool const use_cache = not render_cache.directory.empty();
+
+        if (use_cache and restore_cached_render(render_cache, key, output_path))
+        {
+            std::cout << "render cache: hit " << key.name << std::endl;
+            return 0;
+        }
+
+        if (use_static_scene)
+        {
+            // Same scene, but with every primitive's type known at compile time.
+            constexpr StaticScene scene(floor, s1, v1, c1);
+
+            render_scene(scene);
+        }
+        else
+        {
+            render_scene(objects);
+        }
+
+        if (use_cache)
+        {
+            store_cached_render(render_cache, key, output_path);
+            std::cout << "render cache: stored " << key.name << std::endl;
+        }
+    }
 }
@@ -0,0 +1,246 @@
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cmath>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <rendering/camera.h>
+
+#include <service/render_protocol.h>
+#include <service/unix_socket.h>
+
+/*
+** Submits jobs to a render server (main --serve=<socket>) and measures
+** them. The first job sends the scene and shows the cost of a cold
+** scene; the rest only name it, and are spread over a number of
+** connections at once to measure latency under load and throughput.
+**
+** Latency is given both to the first image bytes, which arrive as soon
+** as the top rows are done, and to the whole image.
+*/
+
+struct Timing
+{
+    double first_byte {};
+    double total      {};
+};
+
+struct Options
+{
+    std::string socket      = "/tmp/zadaca2.sock";
+    std::string scene_file  = "../scenes/kugle.scene";
+    std::string scene_id    = "kugle";
+    std::string output      {};
+    int         width       = 640;
+    int         height      = 360;
+    int         jobs        = 16;
+    int         connections = 4;
+    int         priority    = 0;
+};
+
+// Sends a request and reads the image back, or throws with the server's error.
+Timing submit(
+    Socket        const& socket,
+    SocketReader&        reader,
+    RenderRequest const& request,
+    std::string*  const  image = nullptr)
+{
+    using clock = std::chrono::steady_clock;
+    using std::chrono::duration;
+
+    auto const start = clock::now();
+
+    if (not write_all(socket, format_request(request)))
+        throw std::runtime_error("server closed the connection");
+
+    auto const magic = reader.read_line();
+    auto const first = clock::now();
+
+    if (not magic or *magic != "P6")
+        throw std::runtime_error(magic ? *magic : "server closed the connection");
+
+    auto const size   = reader.read_line();
+    auto const depth  = reader.read_line();
+    auto const pixels = reader.read_bytes(3ull * request.width * request.height);
+
+    if (not size or not depth or not pixels)
+        throw std::runtime_error("image cut short");
+
+    if (image)
+        *image = "P6\n" + *size + '\n' + *depth + '\n' + *pixels;
+
+    return {
+        .first_byte = duration<double, std::milli>(first - start).count(),
+        .total      = duration<double, std::milli>(clock::now() - start).count(),
+    };
+}
+
+void report(
+    char const*                name,
+    std::vector<double> const& values)
+{
+    auto sorted = values;
+    std::ranges::sort(sorted);
+
+    double sum = 0;
+    for (double const value : sorted)
+        sum += value;
+
+    auto const percentile = [&](double const p)
+    {
+        return sorted[std::min(sorted.size() - 1, static_cast<std::size_t>(p * sorted.size()))];
+    };
+
+    std::cout << std::fixed << std::setprecision(1)
+              << std::setw(12) << name
+              << std::setw(10) << sum / sorted.size()
+              << std::setw(10) << percentile(0.5)
+              << std::setw(10) << percentile(0.95)
+              << std::setw(10) << sorted.back()
+              << '\n';
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string_view const arg = argv[i];
+
+        if (arg.starts_with("--socket="))
+            options.socket = arg.substr(9);
+        else if (arg.starts_with("--scene="))
+            options.scene_file = arg.substr(8);
+        else if (arg.starts_with("--scene-id="))
+            options.scene_id = arg.substr(11);
+        else if (arg.starts_with("--output="))
+            options.output = arg.substr(9);
+        else if (arg.starts_with("--width="))
+            options.width = std::stoi(std::string{arg.substr(8)});
+        else if (arg.starts_with("--height="))
+            options.height = std::stoi(std::string{arg.substr(9)});
+        else if (arg.starts_with("--jobs="))
+            options.jobs = std::stoi(std::string{arg.substr(7)});
+        else if (arg.starts_with("--connections="))
+            options.connections = std::stoi(std::string{arg.substr(14)});
+        else if (arg.starts_with("--priority="))
+            options.priority = std::stoi(std::string{arg.substr(11)});
+    }
+
+    std::ifstream     file(options.scene_file);
+    std::stringstream scene;
+    scene << file.rdbuf();
+
+    if (not file)
+    {
+        std::cerr << "can't read " << options.scene_file << '\n';
+        return 1;
+    }
+
+    // main's framing, at whatever resolution was asked for.
+    RenderRequest request
+    {
+        .scene_id = options.scene_id,
+        .width    = options.width,
+        .height   = options.height,
+        .priority = options.priority,
+        .camera   = default_camera(options.width, options.height),
+        .scene    = scene.str(),
+    };
+
+    try
+    {
+        auto const   socket = connect_unix(options.socket);
+        SocketReader reader(socket);
+
+        std::string image;
+        auto const  cold = submit(socket, reader, request, &image);
+
+        std::cout << options.width << 'x' << options.height << ", "
+                  << "cold job (sends the scene): "
+                  << cold.total << " ms" << std::endl;
+
+        if (not options.output.empty())
+            std::ofstream(options.output, std::ofstream::binary) << image;
+    }
+    catch (std::exception const& error)
+    {
+        std::cerr << error.what() << '\n';
+        return 1;
+    }
+
+    request.scene.reset();
+
+    std::vector<Timing>      timings(options.jobs);
+    std::atomic<int>         next   = 0;
+    std::atomic<bool>        failed = false;
+    std::vector<std::thread> connections;
+
+    auto const start = std::chrono::steady_clock::now();
+
+    for (int c = 0; c < options.connections; ++c)
+    {
+        connections.emplace_back([&]
+        {
+            try
+            {
+                auto const   socket = connect_unix(options.socket);
+                SocketReader reader(socket);
+
+                for (int job = next++; job < options.jobs; job = next++)
+                    timings[job] = submit(socket, reader, request);
+            }
+            catch (std::exception const& error)
+            {
+                std::cerr << error.what() << '\n';
+                failed = true;
+            }
+        });
+    }
+
+    for (auto& connection : connections)
+        connection.join();
+
+    if (failed)
+        return 1;
+
+    double const seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start
+    ).count();
+
+    std::vector<double> first_byte;
+    std::vector<double> total;
+
+    for (auto const& timing : timings)
+    {
+        first_byte.push_back(timing.first_byte);
+        total.push_back(timing.total);
+    }
+
+    std::cout << options.jobs << " warm jobs over " << options.connections << " connections\n\n"
+              << std::setw(12) << "latency ms"
+              << std::setw(10) << "mean"
+              << std::setw(10) << "p50"
+              << std::setw(10) << "p95"
+              << std::setw(10) << "max"
+              << '\n';
+
+    report("first byte", first_byte);
+    report("image"     , total);
+
+    double const megabytes = 3.0 * options.width * options.height * options.jobs / (1 << 20);
+
+    std::cout << "\nthroughput: "
+              << options.jobs / seconds << " images/s, "
+              << megabytes / seconds    << " MiB/s\n";
+}